@@ -0,0 +1,683 @@
+/*
+Copyright (c) 2016, sorayuki
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of this program nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Throughput benchmark for the Tawawa filter.
+//
+// Loads avisynth.dll and the plugin, feeds Tawawa() from a synthetic source
+// clip and sweeps resolution, pixel format, kernel (plus preview mode) and
+// thread count. Results go to stdout as CSV, or as JSON with --json.
+//
+// With --verify it instead runs every selectable kernel at every SIMD level
+// the CPU supports directly on noise, grey and colour sweep frames of odd
+// widths, and compares each output byte with a plain per-pixel model.
+// This needs neither avisynth.dll nor the plugin.
+//
+// usage: tawawaBench <TawawaFilter.dll> [--json] [--seconds=<per run>]
+//        tawawaBench --verify
+
+#define NOMINMAX
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../tawawaFilter/Avisynth.h"
+#include "../tawawaFilter/tawawaKernel.h"
+
+typedef IScriptEnvironment* (__stdcall *CreateScriptEnvironmentFunc)(int version);
+
+// Returns one frame of noise for every frame number, so that the timings
+// only cover Tawawa and the LUT sees a realistic access pattern.
+class NoiseSource : public IClip
+{
+	VideoInfo vi;
+	PVideoFrame frame;
+
+public:
+	NoiseSource(int width, int height, int pixelType, IScriptEnvironment* env)
+	{
+		memset(&vi, 0, sizeof(vi));
+		vi.width = width;
+		vi.height = height;
+		vi.pixel_type = pixelType;
+		vi.num_frames = 1 << 30;
+		vi.SetFPS(25, 1);
+
+		frame = env->NewVideoFrame(vi);
+
+		unsigned int seed = 1;
+		static const int planes[3] = { PLANAR_Y, PLANAR_U, PLANAR_V };
+		for (int p = 0; p < (vi.IsPlanar() ? 3 : 1); ++p)
+		{
+			BYTE* pDst = frame->GetWritePtr(planes[p]);
+			int pitch = frame->GetPitch(planes[p]);
+			int rowSize = frame->GetRowSize(planes[p]);
+			int rows = frame->GetHeight(planes[p]);
+
+			for (int y = 0; y < rows; ++y)
+			{
+				for (int x = 0; x < rowSize; ++x)
+				{
+					seed = seed * 1103515245 + 12345;
+					pDst[pitch * y + x] = (BYTE)(seed >> 16);
+				}
+			}
+		}
+	}
+
+	PVideoFrame __stdcall GetFrame(int n, IScriptEnvironment* env) override { return frame; }
+	bool __stdcall GetParity(int n) override { return false; }
+	void __stdcall GetAudio(void* buf, __int64 start, __int64 count, IScriptEnvironment* env) override {}
+	void __stdcall SetCacheHints(int cachehints, int frame_range) override {}
+	const VideoInfo& __stdcall GetVideoInfo() override { return vi; }
+};
+
+struct Resolution
+{
+	int width;
+	int height;
+};
+
+struct Format
+{
+	const char* name;
+	int pixelType;
+};
+
+struct Result
+{
+	std::string format;
+	int width;
+	int height;
+	std::string kernel;
+	int threads;
+	int frames;
+	double seconds;
+	double fps;
+	double gbps;
+	double efficiency;
+};
+
+static double Now()
+{
+	LARGE_INTEGER counter, frequency;
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+	return (double)counter.QuadPart / frequency.QuadPart;
+}
+
+static Result Measure(IScriptEnvironment* env, const PClip& source, const Format& format,
+	TawawaKernelType kernel, bool preview, int threads, double minSeconds)
+{
+	const VideoInfo& vi = source->GetVideoInfo();
+
+	AVSValue args[4] = { source, TawawaKernelName(kernel), threads, preview };
+	const char* names[4] = { 0, "kernel", "threads", "preview" };
+	PClip tawawa = env->Invoke("Tawawa", AVSValue(args, 4), names).AsClip();
+
+	// The first frame warms up the pool and the caches.
+	tawawa->GetFrame(0, env);
+
+	int frames = 0;
+	double start = Now();
+	double elapsed = 0;
+	while (frames < 3 || elapsed < minSeconds)
+	{
+		tawawa->GetFrame(frames + 1, env);
+		++frames;
+		elapsed = Now() - start;
+	}
+
+	Result result;
+	result.format = format.name;
+	result.width = vi.width;
+	result.height = vi.height;
+	result.kernel = preview ? "preview" : TawawaKernelName(kernel);
+	result.threads = threads;
+	result.frames = frames;
+	result.seconds = elapsed;
+	result.fps = frames / elapsed;
+	result.gbps = result.fps * vi.BMPSize() * 2 / 1e9;
+	result.efficiency = 1;
+	return result;
+}
+
+static void PrintCsv(const std::vector<Result>& results)
+{
+	printf("format,width,height,kernel,threads,frames,seconds,fps,gbps,efficiency\n");
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const Result& r = results[i];
+		printf("%s,%d,%d,%s,%d,%d,%.4f,%.2f,%.3f,%.3f\n", r.format.c_str(), r.width, r.height,
+			r.kernel.c_str(), r.threads, r.frames, r.seconds, r.fps, r.gbps, r.efficiency);
+	}
+}
+
+static void PrintJson(const std::vector<Result>& results)
+{
+	printf("[\n");
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const Result& r = results[i];
+		printf("  {\"format\": \"%s\", \"width\": %d, \"height\": %d, \"kernel\": \"%s\", \"threads\": %d, "
+			"\"frames\": %d, \"seconds\": %.4f, \"fps\": %.2f, \"gbps\": %.3f, \"efficiency\": %.3f}%s\n",
+			r.format.c_str(), r.width, r.height, r.kernel.c_str(), r.threads, r.frames, r.seconds,
+			r.fps, r.gbps, r.efficiency, i + 1 < results.size() ? "," : "");
+	}
+	printf("]\n");
+}
+
+// Frame format for --verify.
+struct VerifyFormat
+{
+	const char* name;
+	int pixelType;
+	int bytesPerPixel;
+};
+
+enum VerifyPattern
+{
+	VERIFY_NOISE,
+	VERIFY_GREY,
+	VERIFY_GREY_SPECKLED,
+	VERIFY_COLOURS,
+};
+
+static const char* const verifyPatternNames[] = { "noise", "grey", "grey-speckled", "colours" };
+static const char* const simdNames[] = { "none", "sse2", "ssse3", "avx2" };
+
+// The per-pixel expression of the original RGB24 filter, which the
+// reference kernel has to reproduce bit for bit.
+static void ModelReference(const unsigned char* pcSrc, unsigned char* pcDst)
+{
+	double y = pcSrc[2] * 0.3 + pcSrc[1] * 0.59 + pcSrc[0] * 0.11;
+	y = y / 255 * 200 + 55;
+	if (y > 255) y = 255;
+
+	int iy = y;
+
+	pcDst[2] = (unsigned char)(iy > 85 ? ((y - 85) / 255 * 340) : 0);
+	pcDst[1] = (unsigned char)iy;
+	pcDst[0] = (unsigned char)(iy > 135 ? 255 : iy + 120);
+}
+
+// Tint of one limited range BT.601 luma sample: expanded to a full range
+// luma key, tinted in RGB and converted back with the BT.601 integer
+// formulas. t receives Y, U and V.
+static void ModelYuv(int y, int* t)
+{
+	int key = ((y - 16) * TAWAWA_LUMA_MAX + 109) / 219;
+	key = std::min(std::max(key, 0), (int)TAWAWA_LUMA_MAX);
+
+	int r, g, b;
+	TawawaTint(key, r, g, b);
+
+	t[0] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+	t[1] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+	t[2] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+}
+
+// Source, kernel output and expected output of one frame. Every plane has
+// an odd pitch with padding after each row, which has to stay untouched.
+class VerifyFrame
+{
+	const VerifyFormat& format;
+	int width;
+	int height;
+	int planes;
+	int rowBytes[3];
+	int rows[3];
+	int pitch[3];
+	std::vector<unsigned char> src[3];
+	std::vector<unsigned char> dst[3];
+	std::vector<unsigned char> expected[3];
+
+	TawawaRows Rows(std::vector<unsigned char>* out)
+	{
+		TawawaRows result = {};
+		result.width = width;
+		result.rows = height;
+		for (int p = 0; p < planes; ++p)
+		{
+			result.src[p] = &src[p][0];
+			result.srcPitch[p] = pitch[p];
+			result.dst[p] = &out[p][0];
+			result.dstPitch[p] = pitch[p];
+		}
+		return result;
+	}
+
+public:
+	VerifyFrame(const VerifyFormat& format, int width, int height)
+		: format(format)
+		, width(width)
+		, height(height)
+	{
+		planes = format.pixelType & VideoInfo::CS_PLANAR ? 3 : 1;
+		for (int p = 0; p < planes; ++p)
+		{
+			rowBytes[p] = p == 0 ? width * format.bytesPerPixel : width / 2;
+			rows[p] = p == 0 ? height : height / 2;
+			pitch[p] = rowBytes[p] + 13;
+			src[p].resize(pitch[p] * rows[p]);
+		}
+	}
+
+	void Fill(VerifyPattern pattern, int index, unsigned int& seed)
+	{
+		bool rgb = (format.pixelType & VideoInfo::CS_BGR) != 0;
+
+		for (int p = 0; p < planes; ++p)
+		{
+			for (size_t i = 0; i < src[p].size(); ++i)
+			{
+				seed = seed * 1103515245 + 12345;
+				src[p][i] = (unsigned char)(seed >> 16);
+			}
+		}
+
+		if (pattern == VERIFY_NOISE)
+			return;
+
+		for (int y = 0; y < height; ++y)
+		{
+			unsigned char* row = &src[0][pitch[0] * y];
+
+			for (int x = 0; x < width; ++x)
+			{
+				unsigned char* px = row + x * format.bytesPerPixel;
+
+				if (pattern == VERIFY_COLOURS)
+				{
+					// Consecutive frames walk through all 2^24 colours.
+					if (x < 4096)
+					{
+						unsigned int colour = ((unsigned int)(index * height + y) << 12 | x) & 0xffffff;
+						px[0] = (unsigned char)colour;
+						px[1] = (unsigned char)(colour >> 8);
+						px[2] = (unsigned char)(colour >> 16);
+					}
+				}
+				else if (rgb)
+				{
+					px[1] = px[2] = px[0];
+				}
+				else if (format.bytesPerPixel == 2)
+				{
+					// YUY2: Y stays noise, chroma is neutral.
+					px[1] = 128;
+				}
+			}
+
+			if (pattern == VERIFY_GREY_SPECKLED && rgb)
+			{
+				// One coloured pixel per row sends the row to the colour path.
+				seed = seed * 1103515245 + 12345;
+				row[(seed >> 16) % width * format.bytesPerPixel] ^= 0x5a;
+			}
+		}
+
+		if (pattern != VERIFY_COLOURS && planes == 3)
+		{
+			for (int p = 1; p < 3; ++p)
+				memset(&src[p][0], 128, src[p].size());
+		}
+	}
+
+	// Computes the expected output of a kernel of the given type pixel by
+	// pixel, without the lookup tables: the original expression for the
+	// reference kernel and TawawaTint for all others. YUV chroma is the
+	// rounded mean of the tinted chroma of the pixels sharing it.
+	void Expect(TawawaKernelType type)
+	{
+		for (int p = 0; p < planes; ++p)
+			expected[p].assign(src[p].size(), 0xcd);
+
+		for (int y = 0; y < height; ++y)
+		{
+			const unsigned char* pcSrc = &src[0][pitch[0] * y];
+			unsigned char* pcDst = &expected[0][pitch[0] * y];
+
+			if (format.pixelType & VideoInfo::CS_BGR)
+			{
+				for (int x = 0; x < width; ++x)
+				{
+					const unsigned char* px = pcSrc + x * format.bytesPerPixel;
+					unsigned char* out = pcDst + x * format.bytesPerPixel;
+
+					if (type == TAWAWA_KERNEL_REFERENCE)
+					{
+						ModelReference(px, out);
+					}
+					else
+					{
+						int r, g, b;
+						TawawaTint(TawawaLumaKey(px[2], px[1], px[0]), r, g, b);
+						out[0] = (unsigned char)b;
+						out[1] = (unsigned char)g;
+						out[2] = (unsigned char)r;
+					}
+					if (format.bytesPerPixel == 4)
+						out[3] = px[3];
+				}
+			}
+			else if (format.pixelType == VideoInfo::CS_YUY2)
+			{
+				for (int x = 0; x < width; x += 2)
+				{
+					int t0[3], t1[3];
+					ModelYuv(pcSrc[x * 2], t0);
+					ModelYuv(pcSrc[x * 2 + 2], t1);
+					pcDst[x * 2] = (unsigned char)t0[0];
+					pcDst[x * 2 + 1] = (unsigned char)((t0[1] + t1[1] + 1) / 2);
+					pcDst[x * 2 + 2] = (unsigned char)t1[0];
+					pcDst[x * 2 + 3] = (unsigned char)((t0[2] + t1[2] + 1) / 2);
+				}
+			}
+			else
+			{
+				for (int x = 0; x < width; ++x)
+				{
+					int t[3];
+					ModelYuv(pcSrc[x], t);
+					pcDst[x] = (unsigned char)t[0];
+				}
+
+				if (y % 2 == 0)
+				{
+					for (int x = 0; x < width; x += 2)
+					{
+						int sum[3] = {};
+						for (int i = 0; i < 4; ++i)
+						{
+							int t[3];
+							ModelYuv(pcSrc[pitch[0] * (i / 2) + x + i % 2], t);
+							sum[1] += t[1];
+							sum[2] += t[2];
+						}
+						expected[1][pitch[1] * (y / 2) + x / 2] = (unsigned char)((sum[1] + 2) / 4);
+						expected[2][pitch[2] * (y / 2) + x / 2] = (unsigned char)((sum[2] + 2) / 4);
+					}
+				}
+			}
+		}
+	}
+
+	// Runs kernel and returns the first plane with a byte that differs from
+	// the model for type, or -1. The byte offset is stored in *at.
+	int Compare(TawawaKernelFunc kernel, TawawaKernelType type, const TawawaTables& tables, size_t* at)
+	{
+		for (int p = 0; p < planes; ++p)
+			dst[p].assign(src[p].size(), 0xcd);
+
+		Expect(type);
+		kernel(Rows(dst), tables);
+
+		for (int p = 0; p < planes; ++p)
+		{
+			for (size_t i = 0; i < dst[p].size(); ++i)
+			{
+				if (dst[p][i] != expected[p][i])
+				{
+					*at = i;
+					return p;
+				}
+			}
+		}
+		return -1;
+	}
+
+	void Report(int plane, size_t at)
+	{
+		fprintf(stderr, "  first difference in plane %d at row %d, byte %d: %d instead of %d\n",
+			plane, (int)(at / pitch[plane]), (int)(at % pitch[plane]), dst[plane][at], expected[plane][at]);
+	}
+};
+
+// Returns the number of failed kernel, SIMD level and pattern combinations.
+static int Verify()
+{
+	static const VerifyFormat formats[] = {
+		{ "RGB24", VideoInfo::CS_BGR24, 3 },
+		{ "RGB32", VideoInfo::CS_BGR32, 4 },
+		{ "YUY2", VideoInfo::CS_YUY2, 2 },
+		{ "YV12", VideoInfo::CS_YV12, 1 },
+	};
+	// Odd widths around the SIMD block and span sizes; YUV rounds them down
+	// to even.
+	static const int widths[] = { 1, 3, 5, 15, 17, 31, 33, 63, 65, 1023, 1025, 1031 };
+
+	static TawawaTables tables;
+	tables.Init();
+
+	TawawaSimdLevel detected = TawawaDetectSimd();
+	int failures = 0;
+
+	for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f)
+	{
+		const VerifyFormat& format = formats[f];
+		bool rgb = (format.pixelType & VideoInfo::CS_BGR) != 0;
+
+		for (int s = TAWAWA_SIMD_NONE; s <= detected; ++s)
+		{
+			for (int k = 0; k < TAWAWA_KERNEL_AUTO; ++k)
+			{
+				TawawaKernelType type = (TawawaKernelType)k;
+				TawawaKernelFunc kernel = TawawaSelectKernel(format.pixelType, type, (TawawaSimdLevel)s);
+				if (!kernel)
+					continue;
+
+
+				for (int pattern = VERIFY_NOISE; pattern <= VERIFY_COLOURS; ++pattern)
+				{
+					bool failed = false;
+					unsigned int seed = 1;
+
+					if (pattern == VERIFY_COLOURS)
+					{
+						if (!rgb)
+							continue;
+
+						// 64 frames of 4096 x 64 colours, plus three columns
+						// of noise for the tail of the row.
+						VerifyFrame frame(format, 4099, 64);
+						for (int index = 0; index < 64 && !failed; ++index)
+						{
+							frame.Fill((VerifyPattern)pattern, index, seed);
+
+							size_t at;
+							int plane = frame.Compare(kernel, type, tables, &at);
+							if (plane >= 0)
+							{
+								fprintf(stderr, "%s %s %s %s frame %d: FAILED\n", format.name, TawawaKernelName(type),
+									simdNames[s], verifyPatternNames[pattern], index);
+								frame.Report(plane, at);
+								failed = true;
+							}
+						}
+					}
+					else
+					{
+						for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]) && !failed; ++w)
+						{
+							int width = rgb ? widths[w] : std::max(2, widths[w] & ~1);
+							VerifyFrame frame(format, width, 6);
+							frame.Fill((VerifyPattern)pattern, 0, seed);
+
+							size_t at;
+							int plane = frame.Compare(kernel, type, tables, &at);
+							if (plane >= 0)
+							{
+								fprintf(stderr, "%s %s %s %s width %d: FAILED\n", format.name, TawawaKernelName(type),
+									simdNames[s], verifyPatternNames[pattern], width);
+								frame.Report(plane, at);
+								failed = true;
+							}
+						}
+					}
+
+					if (failed)
+						++failures;
+					else
+						fprintf(stderr, "%s %s %s %s: ok\n", format.name, TawawaKernelName(type),
+							simdNames[s], verifyPatternNames[pattern]);
+				}
+			}
+		}
+	}
+
+	return failures;
+}
+
+int main(int argc, char** argv)
+{
+	const char* pluginPath = 0;
+	bool json = false;
+	bool verify = false;
+	double minSeconds = 0.5;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "--json"))
+			json = true;
+		else if (!strcmp(argv[i], "--verify"))
+			verify = true;
+		else if (!strncmp(argv[i], "--seconds=", 10))
+			minSeconds = atof(argv[i] + 10);
+		else
+			pluginPath = argv[i];
+	}
+
+	if (verify)
+	{
+		int failures = Verify();
+		if (failures)
+			fprintf(stderr, "tawawaBench: %d kernel checks failed.\n", failures);
+		return failures ? 1 : 0;
+	}
+
+	if (!pluginPath)
+	{
+		fprintf(stderr, "usage: %s <TawawaFilter.dll> [--json] [--seconds=<per run>]\n"
+			"       %s --verify\n", argv[0], argv[0]);
+		return 1;
+	}
+
+	HMODULE avisynth = LoadLibraryA("avisynth.dll");
+	CreateScriptEnvironmentFunc createEnv = avisynth
+		? (CreateScriptEnvironmentFunc)GetProcAddress(avisynth, "CreateScriptEnvironment")
+		: 0;
+	if (!createEnv)
+	{
+		fprintf(stderr, "tawawaBench: Cannot load avisynth.dll.\n");
+		return 1;
+	}
+
+	IScriptEnvironment* env = createEnv(AVISYNTH_INTERFACE_VERSION);
+	if (!env)
+	{
+		fprintf(stderr, "tawawaBench: Cannot create a script environment.\n");
+		return 1;
+	}
+
+	static const Resolution resolutions[] = {
+		{ 320, 240 }, { 640, 480 }, { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 }, { 7680, 4320 },
+	};
+	static const Format formats[] = {
+		{ "RGB24", VideoInfo::CS_BGR24 },
+		{ "RGB32", VideoInfo::CS_BGR32 },
+		{ "YUY2", VideoInfo::CS_YUY2 },
+		{ "YV12", VideoInfo::CS_YV12 },
+	};
+
+	TawawaSimdLevel simd = TawawaDetectSimd();
+	int cores = std::max(1, (int)std::thread::hardware_concurrency());
+
+	std::vector<int> threadCounts;
+	for (int t = 1; t < cores; t *= 2)
+		threadCounts.push_back(t);
+	threadCounts.push_back(cores);
+
+	std::vector<Result> results;
+	try
+	{
+		env->Invoke("LoadPlugin", AVSValue(pluginPath));
+
+		for (size_t r = 0; r < sizeof(resolutions) / sizeof(resolutions[0]); ++r)
+		{
+			for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f)
+			{
+				// Filling a large frame with noise takes longer than most
+				// runs, so one source serves the whole kernel and thread sweep.
+				PClip source = new NoiseSource(resolutions[r].width, resolutions[r].height, formats[f].pixelType, env);
+
+				// The last run of each format is preview mode, which keeps the
+				// default kernel name.
+				for (int k = 0; k <= TAWAWA_KERNEL_AUTO; ++k)
+				{
+					TawawaKernelType kernel = (TawawaKernelType)k;
+					bool preview = kernel == TAWAWA_KERNEL_AUTO;
+					if (!preview && !TawawaSelectKernel(formats[f].pixelType, kernel, simd))
+						continue;
+
+					double singleFps = 0;
+					for (size_t t = 0; t < threadCounts.size(); ++t)
+					{
+						Result result = Measure(env, source, formats[f], kernel, preview, threadCounts[t], minSeconds);
+						if (threadCounts[t] == 1)
+							singleFps = result.fps;
+						result.efficiency = result.fps / (singleFps * threadCounts[t]);
+						results.push_back(result);
+
+						fprintf(stderr, "%s %dx%d %s x%d: %.2f fps\n", result.format.c_str(),
+							result.width, result.height, result.kernel.c_str(), result.threads, result.fps);
+					}
+				}
+			}
+		}
+	}
+	catch (const AvisynthError& err)
+	{
+		fprintf(stderr, "tawawaBench: %s\n", err.msg);
+		delete env;
+		return 1;
+	}
+
+	if (json)
+		PrintJson(results);
+	else
+		PrintCsv(results);
+
+	delete env;
+	return 0;
+}
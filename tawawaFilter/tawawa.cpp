@@ -28,63 +28,374 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#define NOMINMAX
 #include <windows.h>
+#include <share.h>
+#include <stdio.h>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
 #include "Avisynth.h"
+#include "tawawaContext.h"
+#include "tawawaKernel.h"
+
+// Rows handed to one worker at a time. Small enough to balance the pool,
+// large enough that the dispatch overhead stays negligible. Must be even
+// so that YV12 bands cover whole chroma rows.
+enum { TAWAWA_BAND_ROWS = 32 };
+
+// Describes a whole source frame and the area of the destination frame it
+// is written to, dstX pixels from the left edge.
+static TawawaRows FrameRows(const VideoInfo& vi, const PVideoFrame& src, unsigned char* const* dst, const int* dstPitch, int dstX)
+{
+	TawawaRows rows = {};
+	rows.width = vi.width;
+	rows.rows = vi.height;
+
+	if (vi.IsPlanar())
+	{
+		static const int planes[3] = { PLANAR_Y, PLANAR_U, PLANAR_V };
+		for (int i = 0; i < 3; ++i)
+		{
+			int x = i == 0 ? dstX : dstX / 2;
+			rows.src[i] = src->GetReadPtr(planes[i]);
+			rows.srcPitch[i] = src->GetPitch(planes[i]);
+			rows.dst[i] = dst[i] + x;
+			rows.dstPitch[i] = dstPitch[i];
+		}
+	}
+	else
+	{
+		rows.src[0] = src->GetReadPtr();
+		rows.srcPitch[0] = src->GetPitch();
+		rows.dst[0] = dst[0] + vi.BytesFromPixels(dstX);
+		rows.dstPitch[0] = dstPitch[0];
+	}
+
+	return rows;
+}
+
+// Write pointers are taken once per frame, before any worker touches it.
+static void WritePlanes(const VideoInfo& vi, const PVideoFrame& frame, unsigned char** dst, int* dstPitch)
+{
+	dst[0] = frame->GetWritePtr();
+	dstPitch[0] = frame->GetPitch();
+	dst[1] = dst[2] = 0;
+	dstPitch[1] = dstPitch[2] = 0;
+
+	if (vi.IsPlanar())
+	{
+		dst[1] = frame->GetWritePtr(PLANAR_U);
+		dst[2] = frame->GetWritePtr(PLANAR_V);
+		dstPitch[1] = dstPitch[2] = frame->GetPitch(PLANAR_U);
+	}
+}
+
+static TawawaKernelFunc ChooseKernel(const char* name, const VideoInfo& vi, const char* kernelName, bool preview, IScriptEnvironment* env)
+{
+	TawawaKernelType type;
+	if (!TawawaParseKernelType(kernelName, type))
+		env->ThrowError("%s: Unknown kernel \"%s\".", name, kernelName);
+
+	TawawaSimdLevel simd = TawawaDetectSimd();
+	TawawaKernelFunc kernel = TawawaSelectKernel(vi.pixel_type, type, simd);
+	if (!kernel)
+	{
+		if (!TawawaSelectKernel(vi.pixel_type, TAWAWA_KERNEL_AUTO, TAWAWA_SIMD_NONE))
+			env->ThrowError("%s: Only RGB24, RGB32, YUY2 and YV12 input is supported.", name);
+		env->ThrowError("%s: Kernel \"%s\" is not available for this input.", name, kernelName);
+	}
+
+	// The kernel is still validated above so that a script with a bad
+	// kernel fails the same way with and without preview.
+	if (preview)
+		kernel = TawawaSelectPreviewKernel(vi.pixel_type, simd);
+	return kernel;
+}
+
+// Stats logs are shared by path. MT hosts may create several instances of
+// one Tawawa call, and each reopening the file with "w" would truncate what
+// the others wrote. g_statsLock also serializes the script variables.
+struct TawawaStatsLog
+{
+	FILE* file;
+	int refcount;
+};
+
+static std::mutex g_statsLock;
+static std::map<std::string, TawawaStatsLog> g_statsLogs;
+
+static FILE* AcquireStatsLog(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(g_statsLock);
+
+	TawawaStatsLog& log = g_statsLogs[path];
+	if (!log.file)
+	{
+		// Unlike fopen_s, _fsopen lets the log be read while it is written.
+		log.file = _fsopen(path.c_str(), "w", _SH_DENYWR);
+		if (!log.file)
+		{
+			g_statsLogs.erase(path);
+			return 0;
+		}
+
+		fprintf(log.file, "frame,clipped");
+		for (int i = 0; i < 256; ++i)
+			fprintf(log.file, ",%d", i);
+		fprintf(log.file, "\n");
+	}
+
+	++log.refcount;
+	return log.file;
+}
+
+static void ReleaseStatsLog(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(g_statsLock);
+
+	std::map<std::string, TawawaStatsLog>::iterator it = g_statsLogs.find(path);
+	if (it != g_statsLogs.end() && --it->second.refcount == 0)
+	{
+		fclose(it->second.file);
+		g_statsLogs.erase(it);
+	}
+}
 
 class TawawaFilter : public GenericVideoFilter
 {
+	TawawaContext* context;
+	TawawaKernelFunc kernel;
+	int threads;
+
+	// Per-frame statistics, see PublishStats.
+	TawawaHistogramFunc histogram;
+	int clipLuma;
+	std::string statsPath;
+	FILE* statsLog;
+	const char* binNames[256];
+
+	void PublishStats(int n, const unsigned int* bins, IScriptEnvironment* env)
+	{
+		// Pixels whose blue channel was clamped to 255 by the tint.
+		int clipped = 0;
+		for (int i = clipLuma; i < 256; ++i)
+			clipped += (int)bins[i];
+
+		// The row is written with one fwrite so that rows of concurrent
+		// frames never interleave.
+		char line[32 + 256 * 11];
+		int length = sprintf_s(line, sizeof(line), "%d,%d", n, clipped);
+		for (int i = 0; i < 256; ++i)
+			length += sprintf_s(line + length, sizeof(line) - length, ",%u", bins[i]);
+		line[length++] = '\n';
+
+		std::lock_guard<std::mutex> lock(g_statsLock);
+
+		env->SetGlobalVar("TawawaFrame", n);
+		env->SetGlobalVar("TawawaClipped", clipped);
+		for (int i = 0; i < 256; ++i)
+			env->SetGlobalVar(binNames[i], (int)bins[i]);
+
+		if (statsLog)
+			fwrite(line, 1, length, statsLog);
+	}
+
 public:
-	TawawaFilter(PClip child, IScriptEnvironment* env)
+	TawawaFilter(PClip child, const char* kernelName, int threads, bool preview, bool stats, const char* statsPath, IScriptEnvironment* env)
 		: GenericVideoFilter(child)
+		, context(0)
+		, threads(threads)
+		, histogram(0)
+		, clipLuma(256)
+		, statsPath(statsPath)
+		, statsLog(0)
 	{
-		if (!vi.IsRGB24())
-			env->ThrowError("TawawaFilter: Only RGB24 input is supported.");
+		kernel = ChooseKernel("TawawaFilter", vi, kernelName, preview, env);
+
+		if (stats || *statsPath)
+		{
+			histogram = TawawaSelectHistogram(vi.pixel_type);
+			for (int i = 0; i < 256; ++i)
+				binNames[i] = env->Sprintf("TawawaHistogram%d", i);
+		}
+
+		if (*statsPath)
+		{
+			statsLog = AcquireStatsLog(this->statsPath);
+			if (!statsLog)
+				env->ThrowError("TawawaFilter: Cannot open \"%s\" for writing.", statsPath);
+		}
+
+		context = TawawaContext::Acquire();
+		clipLuma = TawawaClipLuma(vi.pixel_type, context->GetTables());
+	}
+
+	~TawawaFilter()
+	{
+		if (statsLog)
+			ReleaseStatsLog(statsPath);
+		if (context)
+			context->Release();
 	}
 
 	PVideoFrame __stdcall GetFrame(int n, IScriptEnvironment* env) override
 	{
 		PVideoFrame frame = child->GetFrame(n, env);
 		PVideoFrame newFrame = env->NewVideoFrame(vi);
-		
-		const unsigned char* pSrc = frame->GetReadPtr();
-		unsigned char* pDst = newFrame->GetWritePtr();
 
-		int srcPitch = frame->GetPitch();
-		int dstPitch = newFrame->GetPitch();
+		unsigned char* dst[3];
+		int dstPitch[3];
+		WritePlanes(vi, newFrame, dst, dstPitch);
 
-		for (int ch = 0; ch < vi.height; ++ch)
-		{
-			const unsigned char* pcSrc = pSrc + srcPitch * ch;
-			unsigned char* pcDst = pDst + dstPitch * ch;
+		TawawaRows rows = FrameRows(vi, frame, dst, dstPitch, 0);
+		const TawawaTables& tables = context->GetTables();
+		TawawaKernelFunc process = kernel;
+
+		TawawaHistogramFunc accumulate = histogram;
+
+		int height = vi.height;
+		int bands = (height + TAWAWA_BAND_ROWS - 1) / TAWAWA_BAND_ROWS;
+
+		// One histogram per band, so that workers never share counters.
+		std::vector<unsigned int> bandBins(accumulate ? bands * 256 : 0);
+
+		context->ParallelFor(bands, [&](int band) {
+			int top = band * TAWAWA_BAND_ROWS;
+			TawawaRows bandRows = rows.Band(top, std::min((int)TAWAWA_BAND_ROWS, height - top));
+			process(bandRows, tables);
+			if (accumulate)
+				accumulate(bandRows, &bandBins[band * 256]);
+		}, threads);
 
-			for (int cw = 0; cw < vi.width; ++cw)
+		if (accumulate)
+		{
+			unsigned int bins[256] = {};
+			for (int band = 0; band < bands; ++band)
 			{
-				double y = pcSrc[2] * 0.3 + pcSrc[1] * 0.59 + pcSrc[0] * 0.11;
-				y = y / 255 * 200 + 55;
-				if (y > 255) y = 255;
+				for (int i = 0; i < 256; ++i)
+					bins[i] += bandBins[band * 256 + i];
+			}
+			PublishStats(n, bins, env);
+		}
+
+		return newFrame;
+	}
+};
+
+// Tints several clips of the same format and height and places them side by
+// side. All clips of a frame are processed in a single pool dispatch.
+class TawawaStack : public GenericVideoFilter
+{
+	std::vector<PClip> children;
+	std::vector<int> offsets;
+	TawawaContext* context;
+	TawawaKernelFunc kernel;
+	int threads;
+
+	struct Band
+	{
+		int clip;
+		int top;
+	};
+
+public:
+	TawawaStack(const AVSValue& clips, const char* kernelName, int threads, bool preview, IScriptEnvironment* env)
+		: GenericVideoFilter(clips[0].AsClip())
+		, context(0)
+		, threads(threads)
+	{
+		kernel = ChooseKernel("TawawaStack", vi, kernelName, preview, env);
+
+		vi.width = 0;
+		for (int i = 0; i < clips.ArraySize(); ++i)
+		{
+			PClip clip = clips[i].AsClip();
+			const VideoInfo& cvi = clip->GetVideoInfo();
+
+			if (!cvi.IsSameColorspace(vi))
+				env->ThrowError("TawawaStack: All clips must have the same color format.");
+			if (cvi.height != vi.height)
+				env->ThrowError("TawawaStack: All clips must have the same height.");
+
+			children.push_back(clip);
+			offsets.push_back(vi.width);
+			vi.width += cvi.width;
+			vi.num_frames = std::max(vi.num_frames, cvi.num_frames);
+		}
+
+		context = TawawaContext::Acquire();
+	}
+
+	~TawawaStack()
+	{
+		if (context)
+			context->Release();
+	}
 
-				int iy = y;
+	PVideoFrame __stdcall GetFrame(int n, IScriptEnvironment* env) override
+	{
+		PVideoFrame newFrame = env->NewVideoFrame(vi);
 
-				pcDst[2] = iy > 85 ? ((y - 85) / 255 * 340) : 0;
-				pcDst[1] = iy;
-				pcDst[0] = iy > 135 ? 255 : iy + 120;
+		unsigned char* dst[3];
+		int dstPitch[3];
+		WritePlanes(vi, newFrame, dst, dstPitch);
 
-				pcSrc += 3;
-				pcDst += 3;
+		std::vector<PVideoFrame> frames(children.size());
+		std::vector<TawawaRows> clipRows(children.size());
+		for (size_t i = 0; i < children.size(); ++i)
+		{
+			const VideoInfo& cvi = children[i]->GetVideoInfo();
+			frames[i] = children[i]->GetFrame(std::min(n, cvi.num_frames - 1), env);
+			clipRows[i] = FrameRows(cvi, frames[i], dst, dstPitch, offsets[i]);
+		}
+
+		int height = vi.height;
+		std::vector<Band> bands;
+		for (size_t i = 0; i < children.size(); ++i)
+		{
+			for (int top = 0; top < height; top += TAWAWA_BAND_ROWS)
+			{
+				Band band = { (int)i, top };
+				bands.push_back(band);
 			}
 		}
 
+		const TawawaTables& tables = context->GetTables();
+		TawawaKernelFunc process = kernel;
+		context->ParallelFor((int)bands.size(), [&](int index) {
+			const Band& band = bands[index];
+			int rows = std::min((int)TAWAWA_BAND_ROWS, height - band.top);
+			process(clipRows[band.clip].Band(band.top, rows), tables);
+		}, threads);
+
 		return newFrame;
 	}
 };
 
 AVSValue __cdecl CreateTawawaFilter(AVSValue args, void* user_data, IScriptEnvironment* env)
 {
-	return new TawawaFilter(args[0].AsClip(), env);
+	return new TawawaFilter(args[0].AsClip(), args[1].AsString("auto"), args[2].AsInt(0), args[3].AsBool(false),
+		args[4].AsBool(false), args[5].AsString(""), env);
+}
+
+AVSValue __cdecl CreateTawawaStack(AVSValue args, void* user_data, IScriptEnvironment* env)
+{
+	return new TawawaStack(args[0], args[1].AsString("auto"), args[2].AsInt(0), args[3].AsBool(false), env);
+}
+
+static void __cdecl ReleaseTawawaContext(void* user_data, IScriptEnvironment* env)
+{
+	static_cast<TawawaContext*>(user_data)->Release();
 }
 
 extern "C" __declspec(dllexport) const char* __stdcall AvisynthPluginInit3(IScriptEnvironment* env, void* wtf)
 {
-	env->AddFunction("Tawawa", "c", CreateTawawaFilter, 0);
+	env->AtExit(ReleaseTawawaContext, TawawaContext::Acquire());
+
+	env->AddFunction("Tawawa", "c[kernel]s[threads]i[preview]b[stats]b[statslog]s", CreateTawawaFilter, 0);
+	env->AddFunction("TawawaStack", "c+[kernel]s[threads]i[preview]b", CreateTawawaStack, 0);
 	return "TawawaFilter";
 }
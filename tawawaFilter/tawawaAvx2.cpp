@@ -0,0 +1,112 @@
+/*
+Copyright (c) 2016, sorayuki
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of this program nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// The AVX2 half of TawawaBgr24Layout<TAWAWA_SIMD_AVX2>. This is the only
+// file built with /arch:AVX2: everything else is compiled for legacy SSE,
+// and 256-bit code in the same functions would pay an SSE/AVX transition on
+// every step. Only reached through the kernels TawawaSelectKernel picks for
+// AVX2 CPUs. It takes nothing but the mask tables from the headers, so no
+// AVX2 encoded copy of shared vector code can end up in the link.
+
+#include "tawawaSimd.h"
+
+// AVX2 shuffles within 128-bit lanes, so each lane runs the SSSE3 scheme on
+// its own group of 16 pixels: the low lane on pixels 0-15, the high lane on
+// pixels 16-31 of each step.
+static __m256i LoadMask(const signed char* mask)
+{
+	__m128i m = _mm_loadu_si128((const __m128i*)mask);
+	return _mm256_inserti128_si256(_mm256_castsi128_si256(m), m, 1);
+}
+
+int TawawaBgr24SplitAvx2(const unsigned char* src, unsigned char* b, unsigned char* g, unsigned char* r, int width)
+{
+	unsigned char* planes[3] = { b, g, r };
+	__m256i masks[3][3];
+	for (int c = 0; c < 3; ++c)
+	{
+		for (int k = 0; k < 3; ++k)
+			masks[c][k] = LoadMask(TawawaBgr24Masks::Split(c, k));
+	}
+
+	int i = 0;
+	for (; i + 32 <= width; i += 32)
+	{
+		__m256i block[3];
+		for (int k = 0; k < 3; ++k)
+		{
+			__m128i lo = _mm_loadu_si128((const __m128i*)(src + i * 3 + k * 16));
+			__m128i hi = _mm_loadu_si128((const __m128i*)(src + i * 3 + 48 + k * 16));
+			block[k] = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+		}
+
+		for (int c = 0; c < 3; ++c)
+		{
+			__m256i v = _mm256_shuffle_epi8(block[0], masks[c][0]);
+			v = _mm256_or_si256(v, _mm256_shuffle_epi8(block[1], masks[c][1]));
+			v = _mm256_or_si256(v, _mm256_shuffle_epi8(block[2], masks[c][2]));
+			_mm256_storeu_si256((__m256i*)(planes[c] + i), v);
+		}
+	}
+
+	_mm256_zeroupper();
+	return i;
+}
+
+int TawawaBgr24MergeAvx2(const unsigned char* b, const unsigned char* g, const unsigned char* r, unsigned char* dst, int width)
+{
+	const unsigned char* planes[3] = { b, g, r };
+	__m256i masks[3][3];
+	for (int k = 0; k < 3; ++k)
+	{
+		for (int c = 0; c < 3; ++c)
+			masks[k][c] = LoadMask(TawawaBgr24Masks::Merge(k, c));
+	}
+
+	int i = 0;
+	for (; i + 32 <= width; i += 32)
+	{
+		__m256i plane[3];
+		for (int c = 0; c < 3; ++c)
+			plane[c] = _mm256_loadu_si256((const __m256i*)(planes[c] + i));
+
+		for (int k = 0; k < 3; ++k)
+		{
+			__m256i v = _mm256_shuffle_epi8(plane[0], masks[k][0]);
+			v = _mm256_or_si256(v, _mm256_shuffle_epi8(plane[1], masks[k][1]));
+			v = _mm256_or_si256(v, _mm256_shuffle_epi8(plane[2], masks[k][2]));
+			_mm_storeu_si128((__m128i*)(dst + i * 3 + k * 16), _mm256_castsi256_si128(v));
+			_mm_storeu_si128((__m128i*)(dst + i * 3 + 48 + k * 16), _mm256_extracti128_si256(v, 1));
+		}
+	}
+
+	_mm256_zeroupper();
+	return i;
+}
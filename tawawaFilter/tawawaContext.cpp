@@ -0,0 +1,166 @@
+/*
+Copyright (c) 2016, sorayuki
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of this program nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tawawaContext.h"
+
+static std::mutex g_contextLock;
+static TawawaContext* g_context = 0;
+
+TawawaContext* TawawaContext::Acquire()
+{
+	std::lock_guard<std::mutex> lock(g_contextLock);
+	if (!g_context)
+		g_context = new TawawaContext();
+	++g_context->refcount;
+	return g_context;
+}
+
+void TawawaContext::Release()
+{
+	std::lock_guard<std::mutex> lock(g_contextLock);
+	if (--refcount == 0)
+	{
+		g_context = 0;
+		delete this;
+	}
+}
+
+TawawaContext::TawawaContext()
+	: stopping(false)
+	, refcount(0)
+{
+	tables.Init();
+
+	int threads = (int)std::thread::hardware_concurrency();
+	for (int i = 1; i < threads; ++i)
+		workers.push_back(std::thread(&TawawaContext::WorkerMain, this));
+}
+
+TawawaContext::~TawawaContext()
+{
+	{
+		std::lock_guard<std::mutex> lock(queueLock);
+		stopping = true;
+	}
+	queueCond.notify_all();
+
+	for (size_t i = 0; i < workers.size(); ++i)
+		workers[i].join();
+}
+
+void TawawaContext::ParallelFor(int count, const std::function<void(int)>& fn, int maxThreads)
+{
+	if (count <= 0)
+		return;
+
+	if (count == 1 || maxThreads == 1 || workers.empty())
+	{
+		for (int i = 0; i < count; ++i)
+			fn(i);
+		return;
+	}
+
+	std::shared_ptr<Job> job = std::make_shared<Job>();
+	job->fn = fn;
+	job->count = count;
+	job->maxThreads = maxThreads;
+	job->threads = 1;
+	job->next = 0;
+	job->remaining = count;
+
+	{
+		std::lock_guard<std::mutex> lock(queueLock);
+		queue.push_back(job);
+	}
+	queueCond.notify_all();
+
+	RunJob(job.get());
+
+	std::unique_lock<std::mutex> lock(queueLock);
+	for (std::deque<std::shared_ptr<Job> >::iterator it = queue.begin(); it != queue.end(); ++it)
+	{
+		if (*it == job)
+		{
+			queue.erase(it);
+			break;
+		}
+	}
+	doneCond.wait(lock, [&job] { return job->remaining == 0; });
+}
+
+void TawawaContext::RunJob(Job* job)
+{
+	for (;;)
+	{
+		int i = job->next++;
+		if (i >= job->count)
+			break;
+
+		job->fn(i);
+		--job->remaining;
+	}
+}
+
+void TawawaContext::WorkerMain()
+{
+	std::unique_lock<std::mutex> lock(queueLock);
+	for (;;)
+	{
+		std::shared_ptr<Job> job;
+		for (std::deque<std::shared_ptr<Job> >::iterator it = queue.begin(); it != queue.end();)
+		{
+			if ((*it)->next >= (*it)->count)
+			{
+				it = queue.erase(it);
+				continue;
+			}
+			if (!job && ((*it)->maxThreads <= 0 || (*it)->threads < (*it)->maxThreads))
+				job = *it;
+			++it;
+		}
+
+		if (!job)
+		{
+			if (stopping)
+				return;
+			queueCond.wait(lock);
+			continue;
+		}
+
+		++job->threads;
+		lock.unlock();
+
+		RunJob(job.get());
+
+		lock.lock();
+		--job->threads;
+		doneCond.notify_all();
+	}
+}
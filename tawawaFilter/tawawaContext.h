@@ -0,0 +1,85 @@
+/*
+Copyright (c) 2016, sorayuki
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of this program nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "tawawaKernel.h"
+
+// Process-wide state shared by every Tawawa instance: the lookup tables and
+// one worker pool. Obtained with Acquire() and returned with Release().
+class TawawaContext
+{
+public:
+	static TawawaContext* Acquire();
+	void Release();
+
+	const TawawaTables& GetTables() const { return tables; }
+
+	// Runs fn(0) .. fn(count - 1) on the pool and the calling thread, and
+	// returns once all of them have finished. At most maxThreads threads,
+	// the calling one included, work on it; 0 means no limit.
+	void ParallelFor(int count, const std::function<void(int)>& fn, int maxThreads = 0);
+
+private:
+	struct Job
+	{
+		std::function<void(int)> fn;
+		int count;
+		int maxThreads;
+		int threads;  // guarded by queueLock
+		std::atomic<int> next;
+		std::atomic<int> remaining;
+	};
+
+	TawawaContext();
+	~TawawaContext();
+
+	void WorkerMain();
+	static void RunJob(Job* job);
+
+	TawawaTables tables;
+
+	std::vector<std::thread> workers;
+	std::mutex queueLock;
+	std::condition_variable queueCond;
+	std::condition_variable doneCond;
+	std::deque<std::shared_ptr<Job> > queue;
+	bool stopping;
+
+	int refcount;
+};
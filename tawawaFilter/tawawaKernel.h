@@ -0,0 +1,897 @@
+/*
+Copyright (c) 2016, sorayuki
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of this program nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <windows.h>
+#include <emmintrin.h>
+#include <string.h>
+#include "Avisynth.h"
+#include "tawawaSimd.h"
+
+// Weighted luma sum 30*R + 59*G + 11*B, i.e. 100 times the luma of the
+// original formula, so every possible input maps to one integer key.
+enum { TAWAWA_LUMA_MAX = 255 * 100, TAWAWA_LUT_SIZE = TAWAWA_LUMA_MAX + 1 };
+
+inline int TawawaLumaKey(int r, int g, int b)
+{
+	return r * 30 + g * 59 + b * 11;
+}
+
+// The tint of the original double expression, evaluated exactly:
+// y = key / 100 / 255 * 200 + 55 = 55 + 2 * key / 255.
+inline void TawawaTint(int key, int& r, int& g, int& b)
+{
+	int iy = 55 + key * 2 / 255;
+
+	r = iy > 85 ? (key * 8 - 30600) / 765 : 0;
+	g = iy;
+	b = iy > 135 ? 255 : iy + 120;
+}
+
+// Lookup tables shared by all kernels.
+struct TawawaTables
+{
+	// Tint for a luma key, packed as B | G << 8 | R << 16.
+	unsigned int tint[TAWAWA_LUT_SIZE];
+
+	// Tint for a grey pixel R = G = B = v, packed like tint.
+	unsigned int grayTint[256];
+
+	// Tint for a limited range BT.601 luma sample, packed as Y | U << 8 | V << 16.
+	unsigned int yuvTint[256];
+
+	// Smallest tinted luma (G for RGB, Y for YUV) at which TawawaTint clamps
+	// b to 255. Tinted luma grows with the key, so a pixel was clamped
+	// exactly when its tinted luma is at least this value.
+	int rgbClipLuma;
+	int yuvClipLuma;
+
+	void Init()
+	{
+		rgbClipLuma = yuvClipLuma = 256;
+
+		for (int key = 0; key < TAWAWA_LUT_SIZE; ++key)
+		{
+			int r, g, b;
+			TawawaTint(key, r, g, b);
+			tint[key] = b | g << 8 | r << 16;
+
+			if (g > 135 && g < rgbClipLuma) rgbClipLuma = g;
+		}
+
+		for (int v = 0; v < 256; ++v)
+			grayTint[v] = tint[TawawaLumaKey(v, v, v)];
+
+		for (int y = 0; y < 256; ++y)
+		{
+			int key = ((y - 16) * TAWAWA_LUMA_MAX + 109) / 219;
+			if (key < 0) key = 0;
+			if (key > TAWAWA_LUMA_MAX) key = TAWAWA_LUMA_MAX;
+
+			int r, g, b;
+			TawawaTint(key, r, g, b);
+
+			int ty = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+			int tu = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+			int tv = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+			yuvTint[y] = ty | tu << 8 | tv << 16;
+
+			if (g > 135 && ty < yuvClipLuma) yuvClipLuma = ty;
+		}
+	}
+};
+
+// A horizontal strip of a frame. Packed formats only use plane 0 and leave
+// the others null; YV12 uses plane 1 and 2 for U and V, and rows is then
+// always even.
+struct TawawaRows
+{
+	const unsigned char* src[3];
+	int srcPitch[3];
+	unsigned char* dst[3];
+	int dstPitch[3];
+	int width;
+	int rows;
+
+	// The strip of count rows starting at row top.
+	TawawaRows Band(int top, int count) const
+	{
+		TawawaRows band = *this;
+		for (int i = 0; i < 3; ++i)
+		{
+			int planeTop = i == 0 ? top : top / 2;
+			if (src[i]) band.src[i] = src[i] + srcPitch[i] * planeTop;
+			if (dst[i]) band.dst[i] = dst[i] + dstPitch[i] * planeTop;
+		}
+		band.rows = count;
+		return band;
+	}
+};
+
+// Ways of computing the tint. REFERENCE is the original double expression
+// and FIXED its exact integer form; LUT reads the precomputed tables and
+// SSE2 computes FIXED four pixels at a time. PLANAR splits RGB24 rows into
+// planes, computes FIXED on them in 16-bit lanes and packs the result. AUTO
+// picks the fastest one the format and CPU support.
+enum TawawaKernelType
+{
+	TAWAWA_KERNEL_REFERENCE,
+	TAWAWA_KERNEL_FIXED,
+	TAWAWA_KERNEL_LUT,
+	TAWAWA_KERNEL_SSE2,
+	TAWAWA_KERNEL_PLANAR,
+	TAWAWA_KERNEL_AUTO,
+};
+
+template <TawawaKernelType Type>
+struct TawawaScalarTint;
+
+template <>
+struct TawawaScalarTint<TAWAWA_KERNEL_REFERENCE>
+{
+	static unsigned int Get(int r, int g, int b, const TawawaTables& tables)
+	{
+		double y = r * 0.3 + g * 0.59 + b * 0.11;
+		y = y / 255 * 200 + 55;
+		if (y > 255) y = 255;
+
+		int iy = y;
+
+		unsigned int tr = iy > 85 ? (unsigned int)((y - 85) / 255 * 340) : 0;
+		unsigned int tb = iy > 135 ? 255 : iy + 120;
+		return tb | iy << 8 | tr << 16;
+	}
+};
+
+template <>
+struct TawawaScalarTint<TAWAWA_KERNEL_FIXED>
+{
+	static unsigned int Get(int r, int g, int b, const TawawaTables& tables)
+	{
+		int tr, tg, tb;
+		TawawaTint(TawawaLumaKey(r, g, b), tr, tg, tb);
+		return tb | tg << 8 | tr << 16;
+	}
+};
+
+template <>
+struct TawawaScalarTint<TAWAWA_KERNEL_LUT>
+{
+	static unsigned int Get(int r, int g, int b, const TawawaTables& tables)
+	{
+		return tables.tint[TawawaLumaKey(r, g, b)];
+	}
+};
+
+// Pixel formats. Packed RGB is described by its pixel size and the byte
+// offset of each channel so that the inner loop has no per-pixel decisions.
+template <int Bpp, int OffB, int OffG, int OffR>
+struct TawawaPackedRgb
+{
+	enum { BYTES_PER_PIXEL = Bpp, B = OffB, G = OffG, R = OffR, HAS_ALPHA = Bpp == 4 };
+};
+
+typedef TawawaPackedRgb<3, 0, 1, 2> TawawaRgb24;
+typedef TawawaPackedRgb<4, 0, 1, 2> TawawaRgb32;
+
+struct TawawaYuy2 {};
+struct TawawaYv12 {};
+
+template <class Format, TawawaKernelType Type>
+struct TawawaKernel;
+
+typedef void (*TawawaKernelFunc)(const TawawaRows& rows, const TawawaTables& tables);
+
+template <int Bpp, int OffB, int OffG, int OffR, TawawaKernelType Type>
+struct TawawaKernel<TawawaPackedRgb<Bpp, OffB, OffG, OffR>, Type>
+{
+	typedef TawawaPackedRgb<Bpp, OffB, OffG, OffR> Format;
+
+	static void Process(const TawawaRows& rows, const TawawaTables& tables)
+	{
+		for (int ch = 0; ch < rows.rows; ++ch)
+		{
+			const unsigned char* pcSrc = rows.src[0] + rows.srcPitch[0] * ch;
+			unsigned char* pcDst = rows.dst[0] + rows.dstPitch[0] * ch;
+
+			for (int cw = 0; cw < rows.width; ++cw)
+			{
+				unsigned int tint = TawawaScalarTint<Type>::Get(pcSrc[Format::R], pcSrc[Format::G], pcSrc[Format::B], tables);
+
+				pcDst[Format::R] = (unsigned char)(tint >> 16);
+				pcDst[Format::G] = (unsigned char)(tint >> 8);
+				pcDst[Format::B] = (unsigned char)tint;
+				if (Format::HAS_ALPHA)
+					pcDst[3] = pcSrc[3];
+
+				pcSrc += Format::BYTES_PER_PIXEL;
+				pcDst += Format::BYTES_PER_PIXEL;
+			}
+		}
+	}
+};
+
+// Computes the tint arithmetically, four RGB32 pixels at a time. Quotients
+// are estimated in single precision and corrected by one, which keeps the
+// result identical to TawawaTint since every intermediate is an integer
+// below 2^24.
+template <>
+struct TawawaKernel<TawawaRgb32, TAWAWA_KERNEL_SSE2>
+{
+	static __m128i FloorDiv(__m128 n, __m128 inv, __m128 d)
+	{
+		__m128i q = _mm_cvttps_epi32(_mm_mul_ps(n, inv));
+		__m128 qd = _mm_mul_ps(_mm_cvtepi32_ps(q), d);
+		q = _mm_add_epi32(q, _mm_castps_si128(_mm_cmpgt_ps(qd, n)));
+		q = _mm_sub_epi32(q, _mm_castps_si128(_mm_cmple_ps(_mm_add_ps(qd, d), n)));
+		return q;
+	}
+
+	static __m128i Tint4(__m128i px)
+	{
+		const __m128i mask = _mm_set1_epi32(0xff);
+
+		__m128i b = _mm_and_si128(px, mask);
+		__m128i g = _mm_and_si128(_mm_srli_epi32(px, 8), mask);
+		__m128i r = _mm_and_si128(_mm_srli_epi32(px, 16), mask);
+
+		__m128i key = _mm_add_epi32(_mm_add_epi32(
+			_mm_mullo_epi16(r, _mm_set1_epi32(30)),
+			_mm_mullo_epi16(g, _mm_set1_epi32(59))),
+			_mm_mullo_epi16(b, _mm_set1_epi32(11)));
+		__m128 fkey = _mm_cvtepi32_ps(key);
+
+		__m128i iy = _mm_add_epi32(_mm_set1_epi32(55),
+			FloorDiv(_mm_add_ps(fkey, fkey), _mm_set1_ps(1.0f / 255), _mm_set1_ps(255)));
+
+		__m128i tr = FloorDiv(_mm_sub_ps(_mm_mul_ps(fkey, _mm_set1_ps(8)), _mm_set1_ps(30600)),
+			_mm_set1_ps(1.0f / 765), _mm_set1_ps(765));
+		tr = _mm_and_si128(tr, _mm_cmpgt_epi32(iy, _mm_set1_epi32(85)));
+
+		__m128i tb = _mm_min_epi16(_mm_add_epi32(iy, _mm_set1_epi32(120)), _mm_set1_epi32(255));
+
+		__m128i out = _mm_or_si128(tb, _mm_slli_epi32(iy, 8));
+		out = _mm_or_si128(out, _mm_slli_epi32(tr, 16));
+		return _mm_or_si128(out, _mm_andnot_si128(_mm_set1_epi32(0xffffff), px));
+	}
+
+	static void Process(const TawawaRows& rows, const TawawaTables& tables)
+	{
+		int width4 = rows.width & ~3;
+
+		for (int ch = 0; ch < rows.rows; ++ch)
+		{
+			const unsigned char* pcSrc = rows.src[0] + rows.srcPitch[0] * ch;
+			unsigned char* pcDst = rows.dst[0] + rows.dstPitch[0] * ch;
+
+			for (int cw = 0; cw < width4; cw += 4)
+			{
+				__m128i px = _mm_loadu_si128((const __m128i*)(pcSrc + cw * 4));
+				_mm_storeu_si128((__m128i*)(pcDst + cw * 4), Tint4(px));
+			}
+
+			TawawaRows tail = rows;
+			tail.src[0] = pcSrc + width4 * 4;
+			tail.dst[0] = pcDst + width4 * 4;
+			tail.width = rows.width - width4;
+			tail.rows = 1;
+			TawawaKernel<TawawaRgb32, TAWAWA_KERNEL_FIXED>::Process(tail, tables);
+		}
+	}
+};
+
+// Pixels per row span converted to planes at a time by TawawaPlanarKernel.
+// Three spans stay well inside the L1 cache.
+enum { TAWAWA_PLANAR_SPAN = 1024 };
+
+// Planar-internal RGB24 kernel. Each row is split into B, G and R planes a
+// span at a time with TawawaBgr24Layout, tinted in place by a plain planar
+// loop and merged back, so the tint itself needs no shuffles.
+template <TawawaSimdLevel Isa>
+struct TawawaPlanarKernel
+{
+	// TawawaTint for eight 16-bit keys with exact 16-bit reciprocal
+	// multiplies: x / 255 = x * 0x8081 >> 23, u / 5 = u * 0xcccd >> 18 and
+	// w / 153 = w * 13707 >> 21 hold for every x, u and w that occur here.
+	// (8 * key - 30600) / 765 is evaluated as w / 153 with w = 4 * u / 5,
+	// u = 2 * key - 7650, which keeps every step below 2^16.
+	static void Tint8(__m128i key, __m128i& tb, __m128i& tg, __m128i& tr)
+	{
+		__m128i x = _mm_add_epi16(key, key);
+		__m128i iy = _mm_add_epi16(_mm_srli_epi16(_mm_mulhi_epu16(x, _mm_set1_epi16((short)0x8081)), 7), _mm_set1_epi16(55));
+
+		__m128i u = _mm_subs_epu16(x, _mm_set1_epi16(7650));
+		__m128i a = _mm_srli_epi16(_mm_mulhi_epu16(u, _mm_set1_epi16((short)0xcccd)), 2);
+		__m128i rem = _mm_sub_epi16(u, _mm_mullo_epi16(a, _mm_set1_epi16(5)));
+		__m128i w = _mm_add_epi16(_mm_slli_epi16(a, 2), _mm_subs_epu16(rem, _mm_set1_epi16(1)));
+		__m128i r = _mm_srli_epi16(_mm_mulhi_epu16(w, _mm_set1_epi16(13707)), 5);
+
+		tr = _mm_and_si128(r, _mm_cmpgt_epi16(iy, _mm_set1_epi16(85)));
+		tg = iy;
+		tb = _mm_min_epi16(_mm_add_epi16(iy, _mm_set1_epi16(120)), _mm_set1_epi16(255));
+	}
+
+	static __m128i Key8(__m128i b, __m128i g, __m128i r)
+	{
+		return _mm_add_epi16(_mm_add_epi16(
+			_mm_mullo_epi16(r, _mm_set1_epi16(30)),
+			_mm_mullo_epi16(g, _mm_set1_epi16(59))),
+			_mm_mullo_epi16(b, _mm_set1_epi16(11)));
+	}
+
+	static void TintPlanes(unsigned char* b, unsigned char* g, unsigned char* r, int width, const TawawaTables& tables)
+	{
+		int i = 0;
+		if (Isa >= TAWAWA_SIMD_SSE2)
+		{
+			const __m128i zero = _mm_setzero_si128();
+
+			for (; i + 16 <= width; i += 16)
+			{
+				__m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+				__m128i vg = _mm_loadu_si128((const __m128i*)(g + i));
+				__m128i vr = _mm_loadu_si128((const __m128i*)(r + i));
+
+				__m128i lb, lg, lr, hb, hg, hr;
+				Tint8(Key8(_mm_unpacklo_epi8(vb, zero), _mm_unpacklo_epi8(vg, zero), _mm_unpacklo_epi8(vr, zero)), lb, lg, lr);
+				Tint8(Key8(_mm_unpackhi_epi8(vb, zero), _mm_unpackhi_epi8(vg, zero), _mm_unpackhi_epi8(vr, zero)), hb, hg, hr);
+
+				_mm_storeu_si128((__m128i*)(b + i), _mm_packus_epi16(lb, hb));
+				_mm_storeu_si128((__m128i*)(g + i), _mm_packus_epi16(lg, hg));
+				_mm_storeu_si128((__m128i*)(r + i), _mm_packus_epi16(lr, hr));
+			}
+		}
+
+		for (; i < width; ++i)
+		{
+			unsigned int tint = tables.tint[TawawaLumaKey(r[i], g[i], b[i])];
+			b[i] = (unsigned char)tint;
+			g[i] = (unsigned char)(tint >> 8);
+			r[i] = (unsigned char)(tint >> 16);
+		}
+	}
+
+	static void Process(const TawawaRows& rows, const TawawaTables& tables)
+	{
+		unsigned char planes[3][TAWAWA_PLANAR_SPAN];
+
+		for (int ch = 0; ch < rows.rows; ++ch)
+		{
+			const unsigned char* pcSrc = rows.src[0] + rows.srcPitch[0] * ch;
+			unsigned char* pcDst = rows.dst[0] + rows.dstPitch[0] * ch;
+
+			for (int cw = 0; cw < rows.width; cw += TAWAWA_PLANAR_SPAN)
+			{
+				int span = rows.width - cw < TAWAWA_PLANAR_SPAN ? rows.width - cw : TAWAWA_PLANAR_SPAN;
+
+				TawawaBgr24Layout<Isa>::Split(pcSrc + cw * 3, planes[0], planes[1], planes[2], span);
+				TintPlanes(planes[0], planes[1], planes[2], span, tables);
+				TawawaBgr24Layout<Isa>::Merge(planes[0], planes[1], planes[2], pcDst + cw * 3, span);
+			}
+		}
+	}
+};
+
+// Grey detection for packed RGB rows: true if R = G = B for every pixel.
+// The SSE2 versions compare 16 pixels per step and stop at the first
+// coloured block, so colour content costs next to nothing.
+template <class Format, bool Simd>
+struct TawawaGrayScan
+{
+	static bool IsGray(const unsigned char* pcSrc, int width)
+	{
+		for (int cw = 0; cw < width; ++cw)
+		{
+			if (pcSrc[Format::R] != pcSrc[Format::G] || pcSrc[Format::G] != pcSrc[Format::B])
+				return false;
+			pcSrc += Format::BYTES_PER_PIXEL;
+		}
+		return true;
+	}
+};
+
+template <>
+struct TawawaGrayScan<TawawaRgb24, true>
+{
+	static bool IsGray(const unsigned char* pcSrc, int width)
+	{
+		// Each byte is compared with its successor; in three consecutive
+		// 16 byte blocks these masks select the B == G and G == R pairs.
+		static const int masks[3] = { 0xb6db, 0xdb6d, 0x6db6 };
+
+		int cw = 0;
+		for (; cw + 17 <= width; cw += 16)
+		{
+			const unsigned char* p = pcSrc + cw * 3;
+			for (int k = 0; k < 3; ++k)
+			{
+				__m128i a = _mm_loadu_si128((const __m128i*)(p + k * 16));
+				__m128i b = _mm_loadu_si128((const __m128i*)(p + k * 16 + 1));
+				if ((_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) & masks[k]) != masks[k])
+					return false;
+			}
+		}
+
+		return TawawaGrayScan<TawawaRgb24, false>::IsGray(pcSrc + cw * 3, width - cw);
+	}
+};
+
+template <>
+struct TawawaGrayScan<TawawaRgb32, true>
+{
+	static bool IsGray(const unsigned char* pcSrc, int width)
+	{
+		const __m128i mask = _mm_set1_epi32(0xffff);
+
+		int cw = 0;
+		for (; cw + 16 <= width; cw += 16)
+		{
+			const __m128i* p = (const __m128i*)(pcSrc + cw * 4);
+			__m128i diff = _mm_setzero_si128();
+			for (int k = 0; k < 4; ++k)
+			{
+				__m128i v = _mm_loadu_si128(p + k);
+				diff = _mm_or_si128(diff, _mm_and_si128(_mm_xor_si128(v, _mm_srli_epi32(v, 8)), mask));
+			}
+			if (_mm_movemask_epi8(_mm_cmpeq_epi32(diff, _mm_setzero_si128())) != 0xffff)
+				return false;
+		}
+
+		return TawawaGrayScan<TawawaRgb32, false>::IsGray(pcSrc + cw * 4, width - cw);
+	}
+};
+
+// Wraps a packed RGB kernel with a per-row grey check. Grey rows, such as
+// monochrome material or letterbox bars, take their tint straight from the
+// 256 entry grey table instead of computing the luma.
+template <class Format, class Kernel, bool Simd>
+struct TawawaGrayAwareKernel
+{
+	static void Process(const TawawaRows& rows, const TawawaTables& tables)
+	{
+		for (int ch = 0; ch < rows.rows; ++ch)
+		{
+			const unsigned char* pcSrc = rows.src[0] + rows.srcPitch[0] * ch;
+			unsigned char* pcDst = rows.dst[0] + rows.dstPitch[0] * ch;
+
+			if (!TawawaGrayScan<Format, Simd>::IsGray(pcSrc, rows.width))
+			{
+				Kernel::Process(rows.Band(ch, 1), tables);
+				continue;
+			}
+
+			for (int cw = 0; cw < rows.width; ++cw)
+			{
+				unsigned int tint = tables.grayTint[pcSrc[Format::G]];
+
+				pcDst[Format::R] = (unsigned char)(tint >> 16);
+				pcDst[Format::G] = (unsigned char)(tint >> 8);
+				pcDst[Format::B] = (unsigned char)tint;
+				if (Format::HAS_ALPHA)
+					pcDst[3] = pcSrc[3];
+
+				pcSrc += Format::BYTES_PER_PIXEL;
+				pcDst += Format::BYTES_PER_PIXEL;
+			}
+		}
+	}
+};
+
+template <class Format, class Kernel>
+inline TawawaKernelFunc TawawaGrayAware(bool sse2)
+{
+	return sse2
+		? &TawawaGrayAwareKernel<Format, Kernel, true>::Process
+		: &TawawaGrayAwareKernel<Format, Kernel, false>::Process;
+}
+
+// Y0 U Y1 V. Each luma sample takes its own tinted Y, the shared chroma
+// takes the average of both tinted chroma values.
+template <>
+struct TawawaKernel<TawawaYuy2, TAWAWA_KERNEL_LUT>
+{
+	static void Process(const TawawaRows& rows, const TawawaTables& tables)
+	{
+		for (int ch = 0; ch < rows.rows; ++ch)
+		{
+			const unsigned char* pcSrc = rows.src[0] + rows.srcPitch[0] * ch;
+			unsigned char* pcDst = rows.dst[0] + rows.dstPitch[0] * ch;
+
+			for (int cw = 0; cw < rows.width; cw += 2)
+			{
+				unsigned int t0 = tables.yuvTint[pcSrc[0]];
+				unsigned int t1 = tables.yuvTint[pcSrc[2]];
+
+				pcDst[0] = (unsigned char)t0;
+				pcDst[1] = (unsigned char)((((t0 >> 8) & 0xff) + ((t1 >> 8) & 0xff) + 1) >> 1);
+				pcDst[2] = (unsigned char)t1;
+				pcDst[3] = (unsigned char)(((t0 >> 16) + (t1 >> 16) + 1) >> 1);
+
+				pcSrc += 4;
+				pcDst += 4;
+			}
+		}
+	}
+};
+
+// Each chroma sample takes the average of the four tinted chroma values of
+// the 2x2 luma block it covers.
+template <>
+struct TawawaKernel<TawawaYv12, TAWAWA_KERNEL_LUT>
+{
+	static void Process(const TawawaRows& rows, const TawawaTables& tables)
+	{
+		for (int ch = 0; ch < rows.rows; ch += 2)
+		{
+			const unsigned char* pcSrc0 = rows.src[0] + rows.srcPitch[0] * ch;
+			const unsigned char* pcSrc1 = pcSrc0 + rows.srcPitch[0];
+			unsigned char* pcDst0 = rows.dst[0] + rows.dstPitch[0] * ch;
+			unsigned char* pcDst1 = pcDst0 + rows.dstPitch[0];
+			unsigned char* pcDstU = rows.dst[1] + rows.dstPitch[1] * (ch / 2);
+			unsigned char* pcDstV = rows.dst[2] + rows.dstPitch[2] * (ch / 2);
+
+			for (int cw = 0; cw < rows.width; cw += 2)
+			{
+				unsigned int t0 = tables.yuvTint[pcSrc0[cw]];
+				unsigned int t1 = tables.yuvTint[pcSrc0[cw + 1]];
+				unsigned int t2 = tables.yuvTint[pcSrc1[cw]];
+				unsigned int t3 = tables.yuvTint[pcSrc1[cw + 1]];
+
+				pcDst0[cw] = (unsigned char)t0;
+				pcDst0[cw + 1] = (unsigned char)t1;
+				pcDst1[cw] = (unsigned char)t2;
+				pcDst1[cw + 1] = (unsigned char)t3;
+
+				unsigned int u = ((t0 >> 8) & 0xff) + ((t1 >> 8) & 0xff) + ((t2 >> 8) & 0xff) + ((t3 >> 8) & 0xff);
+				unsigned int v = (t0 >> 16) + (t1 >> 16) + (t2 >> 16) + (t3 >> 16);
+				pcDstU[cw / 2] = (unsigned char)((u + 2) >> 2);
+				pcDstV[cw / 2] = (unsigned char)((v + 2) >> 2);
+			}
+		}
+	}
+};
+
+// Low-latency preview: one tint per 2x2 block, taken from its top left
+// pixel and written to the whole block. Output size and format are those of
+// the full kernels; odd trailing rows and columns become partial blocks.
+// Only the top row of a block is tinted, at half resolution; the bottom row
+// is a copy of it.
+template <class Format, bool Simd>
+struct TawawaPreviewKernel;
+
+// The bottom row of an RGB32 preview block: the tint of the row above with
+// the alpha of its own source row.
+template <bool Simd>
+struct TawawaPreviewAlpha
+{
+	static void Row(unsigned char* pcDst, const unsigned char* pcTop, const unsigned char* pcSrc, int width)
+	{
+		for (int cw = 0; cw < width; ++cw)
+		{
+			unsigned int top, src;
+			memcpy(&top, pcTop + cw * 4, 4);
+			memcpy(&src, pcSrc + cw * 4, 4);
+			top = (top & 0x00ffffff) | (src & 0xff000000);
+			memcpy(pcDst + cw * 4, &top, 4);
+		}
+	}
+};
+
+template <>
+struct TawawaPreviewAlpha<true>
+{
+	static void Row(unsigned char* pcDst, const unsigned char* pcTop, const unsigned char* pcSrc, int width)
+	{
+		const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+		int cw = 0;
+
+		for (; cw + 4 <= width; cw += 4)
+		{
+			__m128i top = _mm_loadu_si128((const __m128i*)(pcTop + cw * 4));
+			__m128i src = _mm_loadu_si128((const __m128i*)(pcSrc + cw * 4));
+			_mm_storeu_si128((__m128i*)(pcDst + cw * 4), _mm_or_si128(_mm_andnot_si128(alpha, top), _mm_and_si128(alpha, src)));
+		}
+
+		TawawaPreviewAlpha<false>::Row(pcDst + cw * 4, pcTop + cw * 4, pcSrc + cw * 4, width - cw);
+	}
+};
+
+template <int Bpp, int OffB, int OffG, int OffR, bool Simd>
+struct TawawaPreviewKernel<TawawaPackedRgb<Bpp, OffB, OffG, OffR>, Simd>
+{
+	typedef TawawaPackedRgb<Bpp, OffB, OffG, OffR> Format;
+
+	static unsigned int Pixel(unsigned int tint)
+	{
+		return (tint & 0xff) << (Format::B * 8) | (tint >> 8 & 0xff) << (Format::G * 8) | (tint >> 16 & 0xff) << (Format::R * 8);
+	}
+
+	static void Put(unsigned char* pcDst, const unsigned char* pcSrc, unsigned int tint)
+	{
+		pcDst[Format::R] = (unsigned char)(tint >> 16);
+		pcDst[Format::G] = (unsigned char)(tint >> 8);
+		pcDst[Format::B] = (unsigned char)tint;
+		if (Format::HAS_ALPHA)
+			pcDst[3] = pcSrc[3];
+	}
+
+	static void TopRow(unsigned char* pcDst, const unsigned char* pcSrc, int width, const TawawaTables& tables)
+	{
+		int rowBytes = width * Format::BYTES_PER_PIXEL;
+		int cw = 0;
+
+		// Both pixels of a block go out in one 8-byte store. For RGB24 it
+		// runs two bytes into the next block, so the last blocks of a row
+		// are written byte by byte.
+		for (; cw * Format::BYTES_PER_PIXEL + 8 <= rowBytes; cw += 2)
+		{
+			int x = cw * Format::BYTES_PER_PIXEL;
+			unsigned int px = Pixel(tables.tint[TawawaLumaKey(pcSrc[x + Format::R], pcSrc[x + Format::G], pcSrc[x + Format::B])]);
+			unsigned __int64 pair;
+
+			if (Format::HAS_ALPHA)
+				pair = (px | (unsigned int)pcSrc[x + 3] << 24) | (unsigned __int64)(px | (unsigned int)pcSrc[x + 7] << 24) << 32;
+			else
+				pair = px | (unsigned __int64)px << (Format::BYTES_PER_PIXEL * 8);
+
+			memcpy(pcDst + x, &pair, 8);
+		}
+
+		for (; cw < width; cw += 2)
+		{
+			int x0 = cw * Format::BYTES_PER_PIXEL;
+			int x1 = cw + 1 < width ? x0 + Format::BYTES_PER_PIXEL : x0;
+			unsigned int tint = tables.tint[TawawaLumaKey(pcSrc[x0 + Format::R], pcSrc[x0 + Format::G], pcSrc[x0 + Format::B])];
+
+			Put(pcDst + x0, pcSrc + x0, tint);
+			Put(pcDst + x1, pcSrc + x1, tint);
+		}
+	}
+
+	static void BottomRow(unsigned char* pcDst, const unsigned char* pcTop, const unsigned char* pcSrc, int width)
+	{
+		if (Format::HAS_ALPHA)
+			TawawaPreviewAlpha<Simd>::Row(pcDst, pcTop, pcSrc, width);
+		else
+			memcpy(pcDst, pcTop, width * Format::BYTES_PER_PIXEL);
+	}
+
+	static void Process(const TawawaRows& rows, const TawawaTables& tables)
+	{
+		for (int ch = 0; ch < rows.rows; ch += 2)
+		{
+			const unsigned char* pcSrc0 = rows.src[0] + rows.srcPitch[0] * ch;
+			unsigned char* pcDst0 = rows.dst[0] + rows.dstPitch[0] * ch;
+
+			TopRow(pcDst0, pcSrc0, rows.width, tables);
+			if (ch + 1 < rows.rows)
+				BottomRow(pcDst0 + rows.dstPitch[0], pcDst0, pcSrc0 + rows.srcPitch[0], rows.width);
+		}
+	}
+};
+
+template <>
+struct TawawaPreviewKernel<TawawaYuy2, false>
+{
+	static void Process(const TawawaRows& rows, const TawawaTables& tables)
+	{
+		for (int ch = 0; ch < rows.rows; ch += 2)
+		{
+			const unsigned char* pcSrc = rows.src[0] + rows.srcPitch[0] * ch;
+			unsigned char* pcDst = rows.dst[0] + rows.dstPitch[0] * ch;
+
+			for (int cw = 0; cw < rows.width; cw += 2)
+			{
+				unsigned int tint = tables.yuvTint[pcSrc[cw * 2]];
+				unsigned int block = (tint & 0xff) * 0x00010001 | (tint & 0xff00) | (tint & 0xff0000) << 8;
+				memcpy(pcDst + cw * 2, &block, 4);
+			}
+
+			if (ch + 1 < rows.rows)
+				memcpy(pcDst + rows.dstPitch[0], pcDst, rows.width * 2);
+		}
+	}
+};
+
+template <>
+struct TawawaPreviewKernel<TawawaYv12, false>
+{
+	static void Process(const TawawaRows& rows, const TawawaTables& tables)
+	{
+		for (int ch = 0; ch < rows.rows; ch += 2)
+		{
+			const unsigned char* pcSrc = rows.src[0] + rows.srcPitch[0] * ch;
+			unsigned char* pcDst = rows.dst[0] + rows.dstPitch[0] * ch;
+			unsigned char* pcDstU = rows.dst[1] + rows.dstPitch[1] * (ch / 2);
+			unsigned char* pcDstV = rows.dst[2] + rows.dstPitch[2] * (ch / 2);
+
+			for (int cw = 0; cw < rows.width; cw += 2)
+			{
+				unsigned int tint = tables.yuvTint[pcSrc[cw]];
+				unsigned short y = (unsigned short)((tint & 0xff) * 0x0101);
+
+				memcpy(pcDst + cw, &y, 2);
+				pcDstU[cw / 2] = (unsigned char)(tint >> 8);
+				pcDstV[cw / 2] = (unsigned char)(tint >> 16);
+			}
+
+			memcpy(pcDst + rows.dstPitch[0], pcDst, rows.width);
+		}
+	}
+};
+
+// Luma histogram of tinted output, accumulated band by band right after the
+// kernel has written it, while the band is still in cache. RGB output counts
+// the G byte, which is the tinted luma itself; YUV output counts Y.
+typedef void (*TawawaHistogramFunc)(const TawawaRows& rows, unsigned int* bins);
+
+template <int Stride, int Offset>
+struct TawawaLumaHistogram
+{
+	static void Accumulate(const TawawaRows& rows, unsigned int* bins)
+	{
+		for (int ch = 0; ch < rows.rows; ++ch)
+		{
+			const unsigned char* pcDst = rows.dst[0] + rows.dstPitch[0] * ch + Offset;
+
+			for (int cw = 0; cw < rows.width; ++cw)
+				++bins[pcDst[cw * Stride]];
+		}
+	}
+};
+
+// First histogram bin of pixels whose blue channel was clamped to 255.
+inline int TawawaClipLuma(int pixelType, const TawawaTables& tables)
+{
+	return pixelType & VideoInfo::CS_BGR ? tables.rgbClipLuma : tables.yuvClipLuma;
+}
+
+inline TawawaHistogramFunc TawawaSelectHistogram(int pixelType)
+{
+	switch (pixelType)
+	{
+	case VideoInfo::CS_BGR24:
+		return &TawawaLumaHistogram<3, 1>::Accumulate;
+	case VideoInfo::CS_BGR32:
+		return &TawawaLumaHistogram<4, 1>::Accumulate;
+	case VideoInfo::CS_YUY2:
+		return &TawawaLumaHistogram<2, 0>::Accumulate;
+	case VideoInfo::CS_YV12:
+	case VideoInfo::CS_I420:
+		return &TawawaLumaHistogram<1, 0>::Accumulate;
+	default:
+		return 0;
+	}
+}
+
+// Picks the kernel for an AviSynth pixel_type once, so that GetFrame never
+// branches on the format. Returns 0 if the format is unsupported or has no
+// kernel of the requested type.
+inline TawawaKernelFunc TawawaSelectKernel(int pixelType, TawawaKernelType type, TawawaSimdLevel simd)
+{
+	bool sse2 = simd >= TAWAWA_SIMD_SSE2;
+
+	if (type == TAWAWA_KERNEL_AUTO)
+	{
+		if (pixelType == VideoInfo::CS_BGR24 && simd >= TAWAWA_SIMD_SSSE3)
+			type = TAWAWA_KERNEL_PLANAR;
+		else if (pixelType == VideoInfo::CS_BGR32 && sse2)
+			type = TAWAWA_KERNEL_SSE2;
+		else
+			type = TAWAWA_KERNEL_LUT;
+	}
+
+	switch (pixelType)
+	{
+	case VideoInfo::CS_BGR24:
+		switch (type)
+		{
+		case TAWAWA_KERNEL_REFERENCE:
+			return &TawawaKernel<TawawaRgb24, TAWAWA_KERNEL_REFERENCE>::Process;
+		case TAWAWA_KERNEL_FIXED:
+			return TawawaGrayAware<TawawaRgb24, TawawaKernel<TawawaRgb24, TAWAWA_KERNEL_FIXED> >(sse2);
+		case TAWAWA_KERNEL_LUT:
+			return TawawaGrayAware<TawawaRgb24, TawawaKernel<TawawaRgb24, TAWAWA_KERNEL_LUT> >(sse2);
+		case TAWAWA_KERNEL_PLANAR:
+			switch (simd)
+			{
+			case TAWAWA_SIMD_AVX2: return TawawaGrayAware<TawawaRgb24, TawawaPlanarKernel<TAWAWA_SIMD_AVX2> >(true);
+			case TAWAWA_SIMD_SSSE3: return TawawaGrayAware<TawawaRgb24, TawawaPlanarKernel<TAWAWA_SIMD_SSSE3> >(true);
+			case TAWAWA_SIMD_SSE2: return TawawaGrayAware<TawawaRgb24, TawawaPlanarKernel<TAWAWA_SIMD_SSE2> >(true);
+			default: return TawawaGrayAware<TawawaRgb24, TawawaPlanarKernel<TAWAWA_SIMD_NONE> >(false);
+			}
+		default:
+			return 0;
+		}
+	case VideoInfo::CS_BGR32:
+		switch (type)
+		{
+		case TAWAWA_KERNEL_REFERENCE:
+			return &TawawaKernel<TawawaRgb32, TAWAWA_KERNEL_REFERENCE>::Process;
+		case TAWAWA_KERNEL_FIXED:
+			return TawawaGrayAware<TawawaRgb32, TawawaKernel<TawawaRgb32, TAWAWA_KERNEL_FIXED> >(sse2);
+		case TAWAWA_KERNEL_LUT:
+			return TawawaGrayAware<TawawaRgb32, TawawaKernel<TawawaRgb32, TAWAWA_KERNEL_LUT> >(sse2);
+		case TAWAWA_KERNEL_SSE2:
+			return sse2 ? TawawaGrayAware<TawawaRgb32, TawawaKernel<TawawaRgb32, TAWAWA_KERNEL_SSE2> >(true) : 0;
+		default:
+			return 0;
+		}
+	case VideoInfo::CS_YUY2:
+		return type == TAWAWA_KERNEL_LUT ? &TawawaKernel<TawawaYuy2, TAWAWA_KERNEL_LUT>::Process : 0;
+	case VideoInfo::CS_YV12:
+	case VideoInfo::CS_I420:
+		return type == TAWAWA_KERNEL_LUT ? &TawawaKernel<TawawaYv12, TAWAWA_KERNEL_LUT>::Process : 0;
+	default:
+		return 0;
+	}
+}
+
+inline TawawaKernelFunc TawawaSelectPreviewKernel(int pixelType, TawawaSimdLevel simd)
+{
+	switch (pixelType)
+	{
+	case VideoInfo::CS_BGR24:
+		return &TawawaPreviewKernel<TawawaRgb24, false>::Process;
+	case VideoInfo::CS_BGR32:
+		if (simd >= TAWAWA_SIMD_SSE2)
+			return &TawawaPreviewKernel<TawawaRgb32, true>::Process;
+		return &TawawaPreviewKernel<TawawaRgb32, false>::Process;
+	case VideoInfo::CS_YUY2:
+		return &TawawaPreviewKernel<TawawaYuy2, false>::Process;
+	case VideoInfo::CS_YV12:
+	case VideoInfo::CS_I420:
+		return &TawawaPreviewKernel<TawawaYv12, false>::Process;
+	default:
+		return 0;
+	}
+}
+
+inline const char* TawawaKernelName(TawawaKernelType type)
+{
+	static const char* const names[] = { "reference", "fixed", "lut", "sse2", "planar", "auto" };
+	return names[type];
+}
+
+// Parses the kernel argument of the script functions. Returns false for an
+// unknown name.
+inline bool TawawaParseKernelType(const char* name, TawawaKernelType& type)
+{
+	for (int i = 0; i <= TAWAWA_KERNEL_AUTO; ++i)
+	{
+		if (!lstrcmpiA(name, TawawaKernelName((TawawaKernelType)i)))
+		{
+			type = (TawawaKernelType)i;
+			return true;
+		}
+	}
+	return false;
+}
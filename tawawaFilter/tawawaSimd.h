@@ -0,0 +1,227 @@
+/*
+Copyright (c) 2016, sorayuki
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of this program nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <intrin.h>
+#include <immintrin.h>
+
+// Instruction set levels the kernels are specialised for, in ascending
+// order. Detected once with TawawaDetectSimd(); AviSynth 2.5 CPU flags stop
+// at SSE3.
+enum TawawaSimdLevel
+{
+	TAWAWA_SIMD_NONE,
+	TAWAWA_SIMD_SSE2,
+	TAWAWA_SIMD_SSSE3,
+	TAWAWA_SIMD_AVX2,
+};
+
+inline TawawaSimdLevel TawawaDetectSimd()
+{
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+
+	__cpuid(info, 1);
+	bool sse2 = (info[3] & (1 << 26)) != 0;
+	bool ssse3 = (info[2] & (1 << 9)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+
+	bool avx2 = false;
+	if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6)
+	{
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+	}
+
+	if (avx2 && ssse3) return TAWAWA_SIMD_AVX2;
+	if (ssse3 && sse2) return TAWAWA_SIMD_SSSE3;
+	if (sse2) return TAWAWA_SIMD_SSE2;
+	return TAWAWA_SIMD_NONE;
+}
+
+// Conversion between packed BGR24 and three byte planes over a span of a
+// row. Split reads width pixels from src into b, g and r; Merge does the
+// reverse. The vector versions handle 16 (SSSE3) or 32 (AVX2) pixels per
+// step with byte shuffles and finish the span with the scalar loop.
+template <TawawaSimdLevel Isa>
+struct TawawaBgr24Layout
+{
+	static void Split(const unsigned char* src, unsigned char* b, unsigned char* g, unsigned char* r, int width)
+	{
+		for (int i = 0; i < width; ++i)
+		{
+			b[i] = src[0];
+			g[i] = src[1];
+			r[i] = src[2];
+			src += 3;
+		}
+	}
+
+	static void Merge(const unsigned char* b, const unsigned char* g, const unsigned char* r, unsigned char* dst, int width)
+	{
+		for (int i = 0; i < width; ++i)
+		{
+			dst[0] = b[i];
+			dst[1] = g[i];
+			dst[2] = r[i];
+			dst += 3;
+		}
+	}
+};
+
+// pshufb controls. splitMasks[c][k] gathers channel c from the k-th 16 byte
+// block of 16 packed pixels; mergeMasks[k][c] scatters plane c into the
+// k-th output block. -1 clears the byte so the three parts can be or-ed.
+struct TawawaBgr24Masks
+{
+	static const signed char* Split(int channel, int block)
+	{
+		static const signed char masks[3][3][16] = {
+			{
+				{ 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+				{ -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1 },
+				{ -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13 },
+			},
+			{
+				{ 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+				{ -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1 },
+				{ -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14 },
+			},
+			{
+				{ 2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+				{ -1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1 },
+				{ -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15 },
+			},
+		};
+		return masks[channel][block];
+	}
+
+	static const signed char* Merge(int block, int channel)
+	{
+		static const signed char masks[3][3][16] = {
+			{
+				{ 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1, 5 },
+				{ -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1 },
+				{ -1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1 },
+			},
+			{
+				{ -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10, -1 },
+				{ 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10 },
+				{ -1, 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1 },
+			},
+			{
+				{ -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1 },
+				{ -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1 },
+				{ 10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15 },
+			},
+		};
+		return masks[block][channel];
+	}
+
+	static __m128i Load(const signed char* mask)
+	{
+		return _mm_loadu_si128((const __m128i*)mask);
+	}
+};
+
+template <>
+struct TawawaBgr24Layout<TAWAWA_SIMD_SSSE3>
+{
+	static void Split(const unsigned char* src, unsigned char* b, unsigned char* g, unsigned char* r, int width)
+	{
+		unsigned char* planes[3] = { b, g, r };
+
+		int i = 0;
+		for (; i + 16 <= width; i += 16)
+		{
+			__m128i block[3];
+			for (int k = 0; k < 3; ++k)
+				block[k] = _mm_loadu_si128((const __m128i*)(src + i * 3 + k * 16));
+
+			for (int c = 0; c < 3; ++c)
+			{
+				__m128i v = _mm_shuffle_epi8(block[0], TawawaBgr24Masks::Load(TawawaBgr24Masks::Split(c, 0)));
+				v = _mm_or_si128(v, _mm_shuffle_epi8(block[1], TawawaBgr24Masks::Load(TawawaBgr24Masks::Split(c, 1))));
+				v = _mm_or_si128(v, _mm_shuffle_epi8(block[2], TawawaBgr24Masks::Load(TawawaBgr24Masks::Split(c, 2))));
+				_mm_storeu_si128((__m128i*)(planes[c] + i), v);
+			}
+		}
+
+		TawawaBgr24Layout<TAWAWA_SIMD_NONE>::Split(src + i * 3, b + i, g + i, r + i, width - i);
+	}
+
+	static void Merge(const unsigned char* b, const unsigned char* g, const unsigned char* r, unsigned char* dst, int width)
+	{
+		const unsigned char* planes[3] = { b, g, r };
+
+		int i = 0;
+		for (; i + 16 <= width; i += 16)
+		{
+			__m128i plane[3];
+			for (int c = 0; c < 3; ++c)
+				plane[c] = _mm_loadu_si128((const __m128i*)(planes[c] + i));
+
+			for (int k = 0; k < 3; ++k)
+			{
+				__m128i v = _mm_shuffle_epi8(plane[0], TawawaBgr24Masks::Load(TawawaBgr24Masks::Merge(k, 0)));
+				v = _mm_or_si128(v, _mm_shuffle_epi8(plane[1], TawawaBgr24Masks::Load(TawawaBgr24Masks::Merge(k, 1))));
+				v = _mm_or_si128(v, _mm_shuffle_epi8(plane[2], TawawaBgr24Masks::Load(TawawaBgr24Masks::Merge(k, 2))));
+				_mm_storeu_si128((__m128i*)(dst + i * 3 + k * 16), v);
+			}
+		}
+
+		TawawaBgr24Layout<TAWAWA_SIMD_NONE>::Merge(b + i, g + i, r + i, dst + i * 3, width - i);
+	}
+};
+
+// Implemented in tawawaAvx2.cpp, the only file built with /arch:AVX2. Both
+// convert the largest multiple of 32 pixels of width, return that count and
+// leave the upper halves of the ymm registers clear.
+int TawawaBgr24SplitAvx2(const unsigned char* src, unsigned char* b, unsigned char* g, unsigned char* r, int width);
+int TawawaBgr24MergeAvx2(const unsigned char* b, const unsigned char* g, const unsigned char* r, unsigned char* dst, int width);
+
+template <>
+struct TawawaBgr24Layout<TAWAWA_SIMD_AVX2>
+{
+	static void Split(const unsigned char* src, unsigned char* b, unsigned char* g, unsigned char* r, int width)
+	{
+		int i = TawawaBgr24SplitAvx2(src, b, g, r, width);
+		TawawaBgr24Layout<TAWAWA_SIMD_SSSE3>::Split(src + i * 3, b + i, g + i, r + i, width - i);
+	}
+
+	static void Merge(const unsigned char* b, const unsigned char* g, const unsigned char* r, unsigned char* dst, int width)
+	{
+		int i = TawawaBgr24MergeAvx2(b, g, r, dst, width);
+		TawawaBgr24Layout<TAWAWA_SIMD_SSSE3>::Merge(b + i, g + i, r + i, dst + i * 3, width - i);
+	}
+};
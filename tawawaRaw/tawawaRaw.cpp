@@ -0,0 +1,449 @@
+/*
+Copyright (c) 2016, sorayuki
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+* Neither the name of this program nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Standalone Tawawa for raw frame dumps.
+//
+// Input and output are memory mapped and the kernels read and write the
+// mappings directly. The frames are split into one contiguous range per
+// thread, and each thread maps its range a window at a time so that large
+// files also fit into a 32-bit address space. Frames larger than a window
+// are mapped and processed in bands of rows.
+//
+// usage: tawawaRaw <input> <output> <width> <height> <format>
+//                  [--threads=<n>] [--kernel=<name>]
+// format: bgr24, bgra32, yuy2, yv12 or i420. Rows are stored top to bottom
+// without padding; planar frames store their three planes back to back.
+
+#define NOMINMAX
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include "../tawawaFilter/Avisynth.h"
+#include "../tawawaFilter/tawawaKernel.h"
+
+// Bytes mapped per view. Each thread maps one input and one output window
+// at a time, and the thread count is capped so that all of them stay within
+// TAWAWA_RAW_ADDRESS_BUDGET of a 32-bit address space.
+enum { TAWAWA_RAW_WINDOW = 16 << 20 };
+enum { TAWAWA_RAW_ADDRESS_BUDGET = 1 << 30 };
+
+// PrefetchVirtualMemory only exists since Windows 8 and is looked up at run
+// time; it is the read-ahead hint madvise(MADV_WILLNEED) gives on POSIX, and
+// the only access hint that applies to mapped views. Flags such as
+// FILE_FLAG_SEQUENTIAL_SCAN only tune read-ahead for ReadFile.
+struct TawawaMemoryRange
+{
+	void* address;
+	SIZE_T size;
+};
+
+typedef BOOL (WINAPI *PrefetchVirtualMemoryFunc)(HANDLE process, ULONG_PTR count, TawawaMemoryRange* ranges, ULONG flags);
+
+struct RawFormat
+{
+	const char* name;
+	int pixelType;
+	bool swapChroma;
+};
+
+static const RawFormat rawFormats[] = {
+	{ "bgr24", VideoInfo::CS_BGR24, false },
+	{ "bgra32", VideoInfo::CS_BGR32, false },
+	{ "yuy2", VideoInfo::CS_YUY2, false },
+	{ "yv12", VideoInfo::CS_YV12, true },
+	{ "i420", VideoInfo::CS_I420, false },
+};
+
+struct RawJob
+{
+	HANDLE input;
+	HANDLE output;
+	const RawFormat* format;
+	TawawaKernelFunc kernel;
+	const TawawaTables* tables;
+	PrefetchVirtualMemoryFunc prefetch;
+	int width;
+	int height;
+	__int64 frameSize;
+	__int64 first;
+	__int64 last;
+	bool failed;
+};
+
+static TawawaTables g_tables;
+
+static __int64 FrameBytes(const RawFormat& format, int width, int height)
+{
+	switch (format.pixelType)
+	{
+	case VideoInfo::CS_BGR24: return (__int64)width * height * 3;
+	case VideoInfo::CS_BGR32: return (__int64)width * height * 4;
+	case VideoInfo::CS_YUY2: return (__int64)width * height * 2;
+	default: return (__int64)width * height * 3 / 2;
+	}
+}
+
+// Byte offset within a frame and pitch of each plane. Packed formats only
+// use plane 0 and leave the other pitches 0.
+static void RawPlanes(const RawJob& job, __int64* offset, int* pitch)
+{
+	offset[0] = offset[1] = offset[2] = 0;
+	pitch[0] = pitch[1] = pitch[2] = 0;
+
+	if (job.format->pixelType & VideoInfo::CS_PLANAR)
+	{
+		int lumaSize = job.width * job.height;
+		int chromaSize = lumaSize / 4;
+		// Plane 1 is U and plane 2 is V; YV12 stores V first.
+		int first = job.format->swapChroma ? 2 : 1;
+		int second = 3 - first;
+
+		offset[first] = lumaSize;
+		offset[second] = lumaSize + chromaSize;
+		pitch[0] = job.width;
+		pitch[1] = pitch[2] = job.width / 2;
+	}
+	else
+	{
+		pitch[0] = (int)(job.frameSize / job.height);
+	}
+}
+
+static TawawaRows RawRows(const RawJob& job, const unsigned char* src, unsigned char* dst)
+{
+	__int64 offset[3];
+	int pitch[3];
+	RawPlanes(job, offset, pitch);
+
+	TawawaRows rows = {};
+	rows.width = job.width;
+	rows.rows = job.height;
+
+	for (int i = 0; i < 3; ++i)
+	{
+		if (!pitch[i])
+			continue;
+		rows.src[i] = src + offset[i];
+		rows.dst[i] = dst + offset[i];
+		rows.srcPitch[i] = rows.dstPitch[i] = pitch[i];
+	}
+
+	return rows;
+}
+
+// Maps size bytes of a file mapping starting at begin, which need not be
+// aligned. Returns the address of begin and stores the view in *view.
+static unsigned char* MapRange(HANDLE mapping, DWORD access, __int64 begin, SIZE_T size, __int64 granularity, void** view)
+{
+	__int64 offset = begin - begin % granularity;
+	*view = MapViewOfFile(mapping, access, (DWORD)(offset >> 32), (DWORD)offset, (SIZE_T)(begin - offset) + size);
+	return *view ? (unsigned char*)*view + (begin - offset) : 0;
+}
+
+static void Prefetch(const RawJob& job, const void* address, SIZE_T size)
+{
+	if (job.prefetch)
+	{
+		TawawaMemoryRange range = { (void*)address, size };
+		job.prefetch(GetCurrentProcess(), 1, &range, 0);
+	}
+}
+
+// Frames that fit into a window: as many whole frames per view as fit.
+static void ProcessFrames(RawJob* job, __int64 granularity)
+{
+	__int64 framesPerView = TAWAWA_RAW_WINDOW / job->frameSize;
+
+	for (__int64 frame = job->first; frame < job->last; frame += framesPerView)
+	{
+		__int64 count = std::min(framesPerView, job->last - frame);
+		SIZE_T size = (SIZE_T)(count * job->frameSize);
+
+		void* srcView;
+		void* dstView;
+		const unsigned char* src = MapRange(job->input, FILE_MAP_READ, frame * job->frameSize, size, granularity, &srcView);
+		unsigned char* dst = MapRange(job->output, FILE_MAP_WRITE, frame * job->frameSize, size, granularity, &dstView);
+
+		if (!src || !dst)
+		{
+			if (srcView) UnmapViewOfFile(srcView);
+			if (dstView) UnmapViewOfFile(dstView);
+			job->failed = true;
+			return;
+		}
+
+		Prefetch(*job, src, size);
+
+		for (__int64 i = 0; i < count; ++i)
+		{
+			SIZE_T at = (SIZE_T)(i * job->frameSize);
+			job->kernel(RawRows(*job, src + at, dst + at), *job->tables);
+		}
+
+		UnmapViewOfFile(srcView);
+		UnmapViewOfFile(dstView);
+	}
+}
+
+// Frames larger than a window: bands of rows, each plane of a band in its
+// own view so that a band never maps more than about a window per file.
+static void ProcessBands(RawJob* job, __int64 granularity)
+{
+	__int64 offset[3];
+	int pitch[3];
+	RawPlanes(*job, offset, pitch);
+
+	// Bands stay even so that planar bands cover whole chroma rows.
+	__int64 rowSize = job->frameSize / job->height;
+	int bandRows = (int)std::min((__int64)job->height, std::max((__int64)2, TAWAWA_RAW_WINDOW / rowSize)) & ~1;
+	if (bandRows == 0)
+		bandRows = job->height;
+
+	for (__int64 frame = job->first; frame < job->last; ++frame)
+	{
+		for (int top = 0; top < job->height; top += bandRows)
+		{
+			int count = std::min(bandRows, job->height - top);
+
+			TawawaRows rows = {};
+			rows.width = job->width;
+			rows.rows = count;
+
+			void* views[6] = {};
+			bool mapped = true;
+
+			for (int i = 0; i < 3 && mapped; ++i)
+			{
+				if (!pitch[i])
+					continue;
+
+				int planeTop = i == 0 ? top : top / 2;
+				int planeRows = i == 0 ? count : count / 2;
+				__int64 begin = frame * job->frameSize + offset[i] + (__int64)planeTop * pitch[i];
+				SIZE_T size = (SIZE_T)planeRows * pitch[i];
+
+				rows.src[i] = MapRange(job->input, FILE_MAP_READ, begin, size, granularity, &views[i * 2]);
+				rows.dst[i] = MapRange(job->output, FILE_MAP_WRITE, begin, size, granularity, &views[i * 2 + 1]);
+				rows.srcPitch[i] = rows.dstPitch[i] = pitch[i];
+				mapped = rows.src[i] && rows.dst[i];
+
+				if (mapped)
+					Prefetch(*job, rows.src[i], size);
+			}
+
+			if (mapped)
+				job->kernel(rows, *job->tables);
+
+			for (int v = 0; v < 6; ++v)
+			{
+				if (views[v])
+					UnmapViewOfFile(views[v]);
+			}
+
+			if (!mapped)
+			{
+				job->failed = true;
+				return;
+			}
+		}
+	}
+}
+
+static void ProcessRange(RawJob* job)
+{
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	__int64 granularity = info.dwAllocationGranularity;
+
+	if (job->frameSize <= TAWAWA_RAW_WINDOW)
+		ProcessFrames(job, granularity);
+	else
+		ProcessBands(job, granularity);
+}
+
+int main(int argc, char** argv)
+{
+	const char* positional[5] = {};
+	int positionals = 0;
+	int threads = 0;
+	const char* kernelName = "auto";
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strncmp(argv[i], "--threads=", 10))
+			threads = atoi(argv[i] + 10);
+		else if (!strncmp(argv[i], "--kernel=", 9))
+			kernelName = argv[i] + 9;
+		else if (positionals < 5)
+			positional[positionals++] = argv[i];
+	}
+
+	if (positionals < 5)
+	{
+		fprintf(stderr, "usage: %s <input> <output> <width> <height> <bgr24|bgra32|yuy2|yv12|i420>"
+			" [--threads=<n>] [--kernel=<name>]\n", argv[0]);
+		return 1;
+	}
+
+	int width = atoi(positional[2]);
+	int height = atoi(positional[3]);
+
+	const RawFormat* format = 0;
+	for (size_t i = 0; i < sizeof(rawFormats) / sizeof(rawFormats[0]); ++i)
+	{
+		if (!lstrcmpiA(positional[4], rawFormats[i].name))
+			format = &rawFormats[i];
+	}
+
+	if (!format)
+	{
+		fprintf(stderr, "tawawaRaw: Unknown format \"%s\".\n", positional[4]);
+		return 1;
+	}
+
+	bool planar = (format->pixelType & VideoInfo::CS_PLANAR) != 0;
+	bool subsampled = planar || format->pixelType == VideoInfo::CS_YUY2;
+	if (width <= 0 || height <= 0 || (subsampled && width % 2) || (planar && height % 2))
+	{
+		fprintf(stderr, "tawawaRaw: Invalid frame size %dx%d for %s.\n", width, height, format->name);
+		return 1;
+	}
+
+	TawawaKernelType type;
+	if (!TawawaParseKernelType(kernelName, type))
+	{
+		fprintf(stderr, "tawawaRaw: Unknown kernel \"%s\".\n", kernelName);
+		return 1;
+	}
+
+	TawawaKernelFunc kernel = TawawaSelectKernel(format->pixelType, type, TawawaDetectSimd());
+	if (!kernel)
+	{
+		fprintf(stderr, "tawawaRaw: Kernel \"%s\" is not available for %s.\n", kernelName, format->name);
+		return 1;
+	}
+
+	HANDLE inputFile = CreateFileA(positional[0], GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, 0);
+	if (inputFile == INVALID_HANDLE_VALUE)
+	{
+		fprintf(stderr, "tawawaRaw: Cannot open \"%s\".\n", positional[0]);
+		return 1;
+	}
+
+	LARGE_INTEGER inputSize;
+	GetFileSizeEx(inputFile, &inputSize);
+
+	__int64 frameSize = FrameBytes(*format, width, height);
+	__int64 frames = inputSize.QuadPart / frameSize;
+	if (frames == 0)
+	{
+		fprintf(stderr, "tawawaRaw: \"%s\" holds no complete %dx%d %s frame.\n", positional[0], width, height, format->name);
+		CloseHandle(inputFile);
+		return 1;
+	}
+	if (inputSize.QuadPart % frameSize)
+		fprintf(stderr, "tawawaRaw: Ignoring %lld trailing bytes.\n", inputSize.QuadPart % frameSize);
+
+	HANDLE outputFile = CreateFileA(positional[1], GENERIC_READ | GENERIC_WRITE, 0, 0, CREATE_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL, 0);
+	if (outputFile == INVALID_HANDLE_VALUE)
+	{
+		fprintf(stderr, "tawawaRaw: Cannot create \"%s\".\n", positional[1]);
+		CloseHandle(inputFile);
+		return 1;
+	}
+
+	__int64 outputSize = frames * frameSize;
+	HANDLE input = CreateFileMappingA(inputFile, 0, PAGE_READONLY, 0, 0, 0);
+	HANDLE output = CreateFileMappingA(outputFile, 0, PAGE_READWRITE,
+		(DWORD)(outputSize >> 32), (DWORD)outputSize, 0);
+	if (!input || !output)
+	{
+		fprintf(stderr, "tawawaRaw: Cannot map the input or output file.\n");
+		if (input) CloseHandle(input);
+		if (output) CloseHandle(output);
+		CloseHandle(inputFile);
+		CloseHandle(outputFile);
+		return 1;
+	}
+
+	g_tables.Init();
+
+	if (threads <= 0)
+		threads = std::max(1, (int)std::thread::hardware_concurrency());
+	threads = std::min(threads, (int)(TAWAWA_RAW_ADDRESS_BUDGET / (2 * TAWAWA_RAW_WINDOW)));
+	threads = (int)std::min((__int64)threads, frames);
+
+	RawJob base = {};
+	base.input = input;
+	base.output = output;
+	base.format = format;
+	base.kernel = kernel;
+	base.tables = &g_tables;
+	base.prefetch = (PrefetchVirtualMemoryFunc)GetProcAddress(GetModuleHandleA("kernel32.dll"), "PrefetchVirtualMemory");
+	base.width = width;
+	base.height = height;
+	base.frameSize = frameSize;
+
+	std::vector<RawJob> jobs(threads, base);
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; ++t)
+	{
+		jobs[t].first = frames * t / threads;
+		jobs[t].last = frames * (t + 1) / threads;
+		workers.push_back(std::thread(ProcessRange, &jobs[t]));
+	}
+
+	bool failed = false;
+	for (int t = 0; t < threads; ++t)
+	{
+		workers[t].join();
+		failed = failed || jobs[t].failed;
+	}
+
+	CloseHandle(input);
+	CloseHandle(output);
+	CloseHandle(inputFile);
+	CloseHandle(outputFile);
+
+	if (failed)
+	{
+		fprintf(stderr, "tawawaRaw: Mapping a view of the files failed.\n");
+		return 1;
+	}
+
+	fprintf(stderr, "tawawaRaw: %lld frames written to \"%s\".\n", frames, positional[1]);
+	return 0;
+}